@@ -31,10 +31,35 @@
 
 // Checksum type. Options:
 //   TF_CKSUM_NONE, TF_CKSUM_XOR, TF_CKSUM_CRC8, TF_CKSUM_CRC16, TF_CKSUM_CRC32
+//   TF_CKSUM_CRC32C - CRC32 with the Castagnoli polynomial, computed by the SSE4.2
+//                     crc32 instruction on x86-64 CPUs that have it (table otherwise)
+//   TF_CKSUM_CRC - CRC with the parameters below
 //   TF_CKSUM_CUSTOM8, TF_CKSUM_CUSTOM16, TF_CKSUM_CUSTOM32
 // Custom checksums require you to implement checksum functions (see TinyFrame.h)
 #define TF_CKSUM_TYPE TF_CKSUM_CRC16
 
+// Parameters of TF_CKSUM_CRC, as listed in CRC catalogues ("Rocksoft model").
+// The lookup table is generated at compile time. For example:
+//   CRC-16/CCITT-FALSE: 16, 0x1021, 0xFFFF, 0, 0
+//   CRC-16/MODBUS:      16, 0x8005, 0xFFFF, 1, 0
+//   CRC-16/KERMIT:      16, 0x1021, 0x0000, 1, 0
+//   CRC-8/SMBUS:         8, 0x07,   0x00,   0, 0
+//#define TF_CRC_WIDTH   16      // 8, 16 or 32
+//#define TF_CRC_POLY    0x1021  // polynomial, not reflected
+//#define TF_CRC_INIT    0xFFFF  // initial value, not reflected
+//#define TF_CRC_REFLECT 0       // 1 if the input and output are reflected (LSB first)
+//#define TF_CRC_XOROUT  0x0000  // value XORed to the result
+
+// Compute CRC16 and CRC32 8 bytes at a time ("slice-by-8"). This is several times
+// faster on long payloads, but the lookup tables take 4 kB (CRC16) or 8 kB (CRC32)
+// of RAM. They're generated when the first instance is initialized.
+#define TF_CKSUM_SLICE8 0
+
+// On x86-64 CPUs with the PCLMULQDQ instruction, compute CRC16 and CRC32 of long
+// payloads (64 bytes or more) by carry-less multiplication. The result is the same.
+// This is checked at run time and has no effect on other platforms.
+#define TF_CKSUM_CLMUL 1
+
 // Use a SOF byte to mark the start of a frame
 #define TF_USE_SOF_BYTE 1
 // Value of the SOF byte (if TF_USE_SOF_BYTE == 1)
@@ -57,8 +82,44 @@ typedef uint8_t TF_COUNT;
 // in multiple calls to the write function. This can be lowered to reduce RAM usage.
 #define TF_SENDBUF_LEN    128
 
+// Send frames through TF_WriteVImpl(), which takes a list of buffers (like writev()),
+// instead of TF_WriteImpl(). A frame sent with TF_Send() etc. is then written in one call
+// with the payload passed as it is, without copying it to the sending buffer.
+#define TF_USE_WRITEV     0
+
+// Collect sent frames in a buffer of this size (0 = disabled) and write them together,
+// when the buffer is full, after TF_TX_FLUSH_TICKS ticks (0 = no time limit), or when
+// TF_Flush() is called. Frames that don't fit in the buffer are written directly.
+#define TF_TX_COALESCE    0
+#define TF_TX_FLUSH_TICKS 1
+
+// Non-blocking transmit. Frames are written with TF_TryWriteImpl(), which may accept only
+// a part of the data. The rest is kept in an outbound buffer of this size (0 = disabled)
+// and written by TF_OnWritable(). If a frame doesn't fit in the buffer, it's not sent at all
+// and TF_TrySend() returns TF_TX_WOULDBLOCK. Can't be combined with TF_USE_WRITEV.
+#define TF_TX_NONBLOCK    0
+
+// Fragmented messages (TF_SendFragmented). A long message is split into frames of type
+// TF_FRAG_TYPE with up to TF_FRAG_LEN bytes of it each, and other frames can be sent between
+// them. The receiver reassembles messages up to TF_FRAG_MAX_RX bytes long. TF_FRAG_TYPE is
+// then reserved, and TF_FRAG_LEN + TF_FRAG_HEAD_BYTES must fit in the peer's TF_MAX_PAYLOAD_RX.
+#define TF_USE_FRAGMENTS  0
+#define TF_FRAG_TYPE      0xFF
+#define TF_FRAG_LEN       256
+#define TF_FRAG_MAX_RX    1024
+
+// Zero-copy receive. If a whole frame is in the buffer given to TF_Accept(),
+// listeners get msg->data pointing into that buffer and the payload isn't copied.
+// Such frames are accepted even if longer than TF_MAX_PAYLOAD_RX.
+// msg->data is then valid only until the listener returns.
+#define TF_USE_ZEROCOPY_RX 0
+
 // --- Listener counts - determine sizes of the static slot tables ---
 
+// ID and Type listeners are looked up through an index - 256 entries of TF_COUNT
+// for 1-byte IDs / types, or a hash table with 2-4x as many entries as listeners
+// for wider ones.
+
 // Frame ID listeners (wait for response / multi-part message)
 #define TF_MAX_ID_LST   10
 // Frame Type listeners (wait for frame with a specific first payload byte)
@@ -66,6 +127,13 @@ typedef uint8_t TF_COUNT;
 // Generic listeners (fallback if no other listener catches it)
 #define TF_MAX_GEN_LST  5
 
+// Allocate listeners with malloc() instead of the tables above. Listener storage grows
+// in slabs of TF_LISTENER_SLAB slots as needed, and empty slabs are freed again.
+// The TF_MAX_*_LST limits are then not used, the number of listeners of each kind is
+// only limited by TF_COUNT (slot + 1 must fit in it).
+#define TF_DYNAMIC_LISTENERS 0
+#define TF_LISTENER_SLAB 16
+
 // Timeout for receiving & parsing a frame
 // ticks = number of calls to TF_Tick()
 #define TF_PARSER_TIMEOUT_TICKS 10
@@ -73,6 +141,10 @@ typedef uint8_t TF_COUNT;
 // Whether to use mutex - requires you to implement TF_ClaimTx() and TF_ReleaseTx()
 #define TF_USE_MUTEX  1
 
+// Frame IDs are taken atomically (TF_Send_Buffered, TF_ComposeFrame) with GCC / clang on targets
+// with lock-free atomics of the size of TF_ID. Uncomment to force it on (1) or off (0).
+//#define TF_ATOMIC_ID 0
+
 // Error reporting function. To disable debug, change to empty define
 #define TF_Error(format, ...) printf("[TF] " format "\n", ##__VA_ARGS__)
 
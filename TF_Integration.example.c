@@ -15,6 +15,20 @@ void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len)
     // send to UART
 }
 
+// Needed instead of TF_WriteImpl() if TF_USE_WRITEV is 1 in the config file.
+//void TF_WriteVImpl(TinyFrame *tf, const TF_IoVec *iov, uint8_t iovcnt)
+//{
+//    // send iov[0] ... iov[iovcnt-1] to UART, e.g. with writev()
+//}
+
+// Needed instead of TF_WriteImpl() if TF_TX_NONBLOCK is not 0 in the config file.
+//uint32_t TF_TryWriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len)
+//{
+//    // give as much as there's room for to the UART without waiting,
+//    // e.g. write() on a non-blocking socket, and return how much it took
+//    return len;
+//}
+
 // --------- Mutex callbacks ----------
 // Needed only if TF_USE_MUTEX is 1 in the config file.
 // DELETE if mutex is not used
@@ -20,6 +20,30 @@
 #define TF_ID_MASK (TF_ID)(((TF_ID)1 << (sizeof(TF_ID)*8 - 1)) - 1)
 #define TF_ID_PEERBIT (TF_ID)((TF_ID)1 << ((sizeof(TF_ID)*8) - 1))
 
+// Take a frame ID. Frames can be composed without the Tx interface claimed (TF_Send_Buffered).
+// The ID is taken atomically only where the target has lock-free atomics of the size of TF_ID,
+// elsewhere (Cortex-M0, AVR, ...) they'd be libatomic calls that bare-metal toolchains may lack.
+// TF_ATOMIC_ID can be defined in TF_Config.h to override the detection.
+#ifndef TF_ATOMIC_ID
+#if TF_ID_BYTES == 1 && defined(__GCC_ATOMIC_CHAR_LOCK_FREE) && __GCC_ATOMIC_CHAR_LOCK_FREE == 2
+    #define TF_ATOMIC_ID 1
+#elif TF_ID_BYTES == 2 && defined(__GCC_ATOMIC_SHORT_LOCK_FREE) && __GCC_ATOMIC_SHORT_LOCK_FREE == 2
+    #define TF_ATOMIC_ID 1
+#elif TF_ID_BYTES == 4 && defined(__GCC_ATOMIC_INT_LOCK_FREE) && __GCC_ATOMIC_INT_LOCK_FREE == 2 && __SIZEOF_INT__ == 4
+    #define TF_ATOMIC_ID 1
+#elif TF_ID_BYTES == 4 && defined(__GCC_ATOMIC_LONG_LOCK_FREE) && __GCC_ATOMIC_LONG_LOCK_FREE == 2 && __SIZEOF_LONG__ == 4
+    #define TF_ATOMIC_ID 1
+#else
+    #define TF_ATOMIC_ID 0
+#endif
+#endif // TF_ATOMIC_ID
+
+#if TF_ATOMIC_ID
+    #define TF_TAKE_ID(tf) __atomic_fetch_add(&(tf)->next_id, 1, __ATOMIC_RELAXED)
+#else
+    #define TF_TAKE_ID(tf) ((tf)->next_id++)
+#endif
+
 
 #if !TF_USE_MUTEX
     // Not thread safe lock implementation, used if user did not provide a better one.
@@ -44,6 +68,21 @@
     }
 #endif
 
+#if TF_TX_NONBLOCK || (TF_TX_COALESCE && TF_TX_FLUSH_TICKS)
+/**
+ * Claim the Tx interface for housekeeping that can be skipped while a frame is being
+ * sent - the soft lock being taken is then not an error. The functions using this may
+ * run in another thread than the senders, or in a listener during a send.
+ */
+static inline bool tx_try_claim(TinyFrame *tf)
+{
+#if !TF_USE_MUTEX
+    if (tf->soft_lock) return false;
+#endif
+    return TF_ClaimTx(tf);
+}
+#endif
+
 //region Checksums
 
 #if TF_CKSUM_TYPE == TF_CKSUM_NONE
@@ -68,6 +107,29 @@
     static TF_CKSUM TF_CksumEnd(TF_CKSUM cksum)
       { return (TF_CKSUM) ~cksum; }
 
+    /** XOR 8 bytes at a time, then fold the word into a byte. Compilers vectorize the loop. */
+    static TF_CKSUM TF_CksumAddBuf(TF_CKSUM cksum, const uint8_t *buf, uint32_t len)
+    {
+        uint64_t acc = 0;
+        uint64_t word;
+        while (len >= 8) {
+            memcpy(&word, buf, 8); // unaligned load
+            acc ^= word;
+            buf += 8;
+            len -= 8;
+        }
+        acc ^= acc >> 32;
+        acc ^= acc >> 16;
+        acc ^= acc >> 8;
+        cksum ^= (uint8_t) acc;
+
+        while (len-- > 0) {
+            cksum ^= *buf++;
+        }
+        return cksum;
+    }
+    #define TF_CKSUM_HAVE_ADDBUF 1
+
 #elif TF_CKSUM_TYPE == TF_CKSUM_CRC8
 
     static inline uint8_t crc8_bits(uint8_t data)
@@ -140,6 +202,46 @@
 
     static TF_CKSUM TF_CksumEnd(TF_CKSUM cksum)
       { return cksum; }
+#if TF_CKSUM_SLICE8
+    /** crc16_slice[k][n] = CRC of byte n followed by k zero bytes. Built by crc_slice_init(). */
+    static uint16_t crc16_slice[8][256];
+    static bool crc16_slice_ready = false;
+
+    static void crc_slice_init(void)
+    {
+        uint16_t n, k;
+        if (crc16_slice_ready) return;
+
+        for (n = 0; n < 256; n++) {
+            crc16_slice[0][n] = crc16_table[n];
+        }
+        for (k = 1; k < 8; k++) {
+            for (n = 0; n < 256; n++) {
+                uint16_t c = crc16_slice[k - 1][n];
+                crc16_slice[k][n] = (uint16_t) ((c >> 8) ^ crc16_table[c & 0xff]);
+            }
+        }
+        crc16_slice_ready = true;
+    }
+    static TF_CKSUM crc_add_sliced(TF_CKSUM cksum, const uint8_t *buf, uint32_t len)
+    {
+        uint32_t x;
+        while (len >= 8) {
+            x = cksum ^ (buf[0] | (uint32_t) buf[1] << 8);
+            cksum = crc16_slice[7][x & 0xff] ^ crc16_slice[6][x >> 8]
+                  ^ crc16_slice[5][buf[2]] ^ crc16_slice[4][buf[3]]
+                  ^ crc16_slice[3][buf[4]] ^ crc16_slice[2][buf[5]]
+                  ^ crc16_slice[1][buf[6]] ^ crc16_slice[0][buf[7]];
+            buf += 8;
+            len -= 8;
+        }
+        while (len-- > 0) {
+            cksum = TF_CksumAdd(cksum, *buf++);
+        }
+        return cksum;
+    }
+    #define TF_CKSUM_SLICED 1
+#endif
 
 #elif TF_CKSUM_TYPE == TF_CKSUM_CRC32
 
@@ -199,7 +301,495 @@
     static TF_CKSUM TF_CksumEnd(TF_CKSUM cksum)
       { return (TF_CKSUM) ~cksum; }
 
+#if TF_CKSUM_SLICE8
+    /** crc32_slice[k][n] = CRC of byte n followed by k zero bytes. Built by crc_slice_init(). */
+    static uint32_t crc32_slice[8][256];
+    static bool crc32_slice_ready = false;
+
+    static void crc_slice_init(void)
+    {
+        uint32_t n, k;
+        if (crc32_slice_ready) return;
+
+        for (n = 0; n < 256; n++) {
+            crc32_slice[0][n] = crc32_table[n];
+        }
+        for (k = 1; k < 8; k++) {
+            for (n = 0; n < 256; n++) {
+                uint32_t c = crc32_slice[k - 1][n];
+                crc32_slice[k][n] = (c >> 8) ^ crc32_table[c & 0xff];
+            }
+        }
+        crc32_slice_ready = true;
+    }
+    static TF_CKSUM crc_add_sliced(TF_CKSUM cksum, const uint8_t *buf, uint32_t len)
+    {
+        uint32_t lo, hi;
+        while (len >= 8) {
+            lo = cksum ^ (buf[0] | (uint32_t) buf[1] << 8 | (uint32_t) buf[2] << 16 | (uint32_t) buf[3] << 24);
+            hi = buf[4] | (uint32_t) buf[5] << 8 | (uint32_t) buf[6] << 16 | (uint32_t) buf[7] << 24;
+            cksum = crc32_slice[7][lo & 0xff] ^ crc32_slice[6][(lo >> 8) & 0xff]
+                  ^ crc32_slice[5][(lo >> 16) & 0xff] ^ crc32_slice[4][lo >> 24]
+                  ^ crc32_slice[3][hi & 0xff] ^ crc32_slice[2][(hi >> 8) & 0xff]
+                  ^ crc32_slice[1][(hi >> 16) & 0xff] ^ crc32_slice[0][hi >> 24];
+            buf += 8;
+            len -= 8;
+        }
+        while (len-- > 0) {
+            cksum = TF_CksumAdd(cksum, *buf++);
+        }
+        return cksum;
+    }
+    #define TF_CKSUM_SLICED 1
+#endif
+
+#elif TF_CKSUM_TYPE == TF_CKSUM_CRC32C
+
+    static const uint32_t crc32c_table[] = { /* CRC polynomial 0x82f63b78 (Castagnoli) */
+        0x00000000, 0xf26b8303, 0xe13b70f7, 0x1350f3f4, 0xc79a971f, 0x35f1141c,
+        0x26a1e7e8, 0xd4ca64eb, 0x8ad958cf, 0x78b2dbcc, 0x6be22838, 0x9989ab3b,
+        0x4d43cfd0, 0xbf284cd3, 0xac78bf27, 0x5e133c24, 0x105ec76f, 0xe235446c,
+        0xf165b798, 0x030e349b, 0xd7c45070, 0x25afd373, 0x36ff2087, 0xc494a384,
+        0x9a879fa0, 0x68ec1ca3, 0x7bbcef57, 0x89d76c54, 0x5d1d08bf, 0xaf768bbc,
+        0xbc267848, 0x4e4dfb4b, 0x20bd8ede, 0xd2d60ddd, 0xc186fe29, 0x33ed7d2a,
+        0xe72719c1, 0x154c9ac2, 0x061c6936, 0xf477ea35, 0xaa64d611, 0x580f5512,
+        0x4b5fa6e6, 0xb93425e5, 0x6dfe410e, 0x9f95c20d, 0x8cc531f9, 0x7eaeb2fa,
+        0x30e349b1, 0xc288cab2, 0xd1d83946, 0x23b3ba45, 0xf779deae, 0x05125dad,
+        0x1642ae59, 0xe4292d5a, 0xba3a117e, 0x4851927d, 0x5b016189, 0xa96ae28a,
+        0x7da08661, 0x8fcb0562, 0x9c9bf696, 0x6ef07595, 0x417b1dbc, 0xb3109ebf,
+        0xa0406d4b, 0x522bee48, 0x86e18aa3, 0x748a09a0, 0x67dafa54, 0x95b17957,
+        0xcba24573, 0x39c9c670, 0x2a993584, 0xd8f2b687, 0x0c38d26c, 0xfe53516f,
+        0xed03a29b, 0x1f682198, 0x5125dad3, 0xa34e59d0, 0xb01eaa24, 0x42752927,
+        0x96bf4dcc, 0x64d4cecf, 0x77843d3b, 0x85efbe38, 0xdbfc821c, 0x2997011f,
+        0x3ac7f2eb, 0xc8ac71e8, 0x1c661503, 0xee0d9600, 0xfd5d65f4, 0x0f36e6f7,
+        0x61c69362, 0x93ad1061, 0x80fde395, 0x72966096, 0xa65c047d, 0x5437877e,
+        0x4767748a, 0xb50cf789, 0xeb1fcbad, 0x197448ae, 0x0a24bb5a, 0xf84f3859,
+        0x2c855cb2, 0xdeeedfb1, 0xcdbe2c45, 0x3fd5af46, 0x7198540d, 0x83f3d70e,
+        0x90a324fa, 0x62c8a7f9, 0xb602c312, 0x44694011, 0x5739b3e5, 0xa55230e6,
+        0xfb410cc2, 0x092a8fc1, 0x1a7a7c35, 0xe811ff36, 0x3cdb9bdd, 0xceb018de,
+        0xdde0eb2a, 0x2f8b6829, 0x82f63b78, 0x709db87b, 0x63cd4b8f, 0x91a6c88c,
+        0x456cac67, 0xb7072f64, 0xa457dc90, 0x563c5f93, 0x082f63b7, 0xfa44e0b4,
+        0xe9141340, 0x1b7f9043, 0xcfb5f4a8, 0x3dde77ab, 0x2e8e845f, 0xdce5075c,
+        0x92a8fc17, 0x60c37f14, 0x73938ce0, 0x81f80fe3, 0x55326b08, 0xa759e80b,
+        0xb4091bff, 0x466298fc, 0x1871a4d8, 0xea1a27db, 0xf94ad42f, 0x0b21572c,
+        0xdfeb33c7, 0x2d80b0c4, 0x3ed04330, 0xccbbc033, 0xa24bb5a6, 0x502036a5,
+        0x4370c551, 0xb11b4652, 0x65d122b9, 0x97baa1ba, 0x84ea524e, 0x7681d14d,
+        0x2892ed69, 0xdaf96e6a, 0xc9a99d9e, 0x3bc21e9d, 0xef087a76, 0x1d63f975,
+        0x0e330a81, 0xfc588982, 0xb21572c9, 0x407ef1ca, 0x532e023e, 0xa145813d,
+        0x758fe5d6, 0x87e466d5, 0x94b49521, 0x66df1622, 0x38cc2a06, 0xcaa7a905,
+        0xd9f75af1, 0x2b9cd9f2, 0xff56bd19, 0x0d3d3e1a, 0x1e6dcdee, 0xec064eed,
+        0xc38d26c4, 0x31e6a5c7, 0x22b65633, 0xd0ddd530, 0x0417b1db, 0xf67c32d8,
+        0xe52cc12c, 0x1747422f, 0x49547e0b, 0xbb3ffd08, 0xa86f0efc, 0x5a048dff,
+        0x8ecee914, 0x7ca56a17, 0x6ff599e3, 0x9d9e1ae0, 0xd3d3e1ab, 0x21b862a8,
+        0x32e8915c, 0xc083125f, 0x144976b4, 0xe622f5b7, 0xf5720643, 0x07198540,
+        0x590ab964, 0xab613a67, 0xb831c993, 0x4a5a4a90, 0x9e902e7b, 0x6cfbad78,
+        0x7fab5e8c, 0x8dc0dd8f, 0xe330a81a, 0x115b2b19, 0x020bd8ed, 0xf0605bee,
+        0x24aa3f05, 0xd6c1bc06, 0xc5914ff2, 0x37faccf1, 0x69e9f0d5, 0x9b8273d6,
+        0x88d28022, 0x7ab90321, 0xae7367ca, 0x5c18e4c9, 0x4f48173d, 0xbd23943e,
+        0xf36e6f75, 0x0105ec76, 0x12551f82, 0xe03e9c81, 0x34f4f86a, 0xc69f7b69,
+        0xd5cf889d, 0x27a40b9e, 0x79b737ba, 0x8bdcb4b9, 0x988c474d, 0x6ae7c44e,
+        0xbe2da0a5, 0x4c4623a6, 0x5f16d052, 0xad7d5351
+    };
+
+    static TF_CKSUM TF_CksumStart(void)
+      { return (TF_CKSUM)0xFFFFFFFF; }
+
+    static TF_CKSUM TF_CksumAdd(TF_CKSUM cksum, uint8_t byte)
+      { return crc32c_table[(cksum ^ byte) & 0xff] ^ (cksum >> 8); }
+
+    static TF_CKSUM TF_CksumEnd(TF_CKSUM cksum)
+      { return (TF_CKSUM) ~cksum; }
+
+#elif TF_CKSUM_TYPE == TF_CKSUM_CRC
+
+    // CRC with parameters from TF_Config.h. The lookup table is generated by the preprocessor:
+    // table entries are XORs of the entries for single bits (CRC is linear), and those 8 basis
+    // values are computed with enum constants, one byte at a time, so they fit in any int.
+
+    #define TF_CRC__NBYTES (TF_CRC_WIDTH / 8)
+
+    /** Reverse bits in a byte */
+    #define TF_CRC__REV8(b) ((((b) & 0x01) << 7) | (((b) & 0x02) << 5) | (((b) & 0x04) << 3) | (((b) & 0x08) << 1) | \
+                             (((b) & 0x10) >> 1) | (((b) & 0x20) >> 3) | (((b) & 0x40) >> 5) | (((b) & 0x80) >> 7))
+
+    /** Byte j of x reflected over TF_CRC_WIDTH bits (0 past the width) */
+    #define TF_CRC__RBYTE(x, j) ((j) < TF_CRC__NBYTES ? \
+        TF_CRC__REV8(((uint32_t) (x) >> (8 * ((TF_CRC__NBYTES - 1 - (j)) & 3))) & 0xFF) : 0)
+
+    /** Byte j of x (0 past the width) */
+    #define TF_CRC__BYTE(x, j) ((j) < TF_CRC__NBYTES ? ((uint32_t) (x) >> (8 * (j))) & 0xFF : 0)
+
+    #define TF_CRC__JOIN(b0, b1, b2, b3) \
+        ((uint32_t) (b0) | ((uint32_t) (b1) << 8) | ((uint32_t) (b2) << 16) | ((uint32_t) (b3) << 24))
+
+#if TF_CRC_REFLECT
+    // Reflected: the register shifts right, entry for bit 7 is the reflected polynomial.
+    // Each lower bit's entry is the next one shifted right by one bit and reduced.
+    enum {
+        TF_CRC__P0 = TF_CRC__RBYTE(TF_CRC_POLY, 0),
+        TF_CRC__P1 = TF_CRC__RBYTE(TF_CRC_POLY, 1),
+        TF_CRC__P2 = TF_CRC__RBYTE(TF_CRC_POLY, 2),
+        TF_CRC__P3 = TF_CRC__RBYTE(TF_CRC_POLY, 3),
+    };
+
+    #define TF_CRC__STEP(prev, next) \
+        next##_0 = (((prev##_0 >> 1) | ((prev##_1 & 1) << 7)) ^ ((prev##_0 & 1) * TF_CRC__P0)), \
+        next##_1 = (((prev##_1 >> 1) | ((prev##_2 & 1) << 7)) ^ ((prev##_0 & 1) * TF_CRC__P1)), \
+        next##_2 = (((prev##_2 >> 1) | ((prev##_3 & 1) << 7)) ^ ((prev##_0 & 1) * TF_CRC__P2)), \
+        next##_3 = ((prev##_3 >> 1) ^ ((prev##_0 & 1) * TF_CRC__P3))
+
+    enum {
+        TF_CRC__B7_0 = TF_CRC__P0, TF_CRC__B7_1 = TF_CRC__P1, TF_CRC__B7_2 = TF_CRC__P2, TF_CRC__B7_3 = TF_CRC__P3,
+        TF_CRC__STEP(TF_CRC__B7, TF_CRC__B6),
+        TF_CRC__STEP(TF_CRC__B6, TF_CRC__B5),
+        TF_CRC__STEP(TF_CRC__B5, TF_CRC__B4),
+        TF_CRC__STEP(TF_CRC__B4, TF_CRC__B3),
+        TF_CRC__STEP(TF_CRC__B3, TF_CRC__B2),
+        TF_CRC__STEP(TF_CRC__B2, TF_CRC__B1),
+        TF_CRC__STEP(TF_CRC__B1, TF_CRC__B0),
+    };
+
+    #define TF_CRC__RPOLY TF_CRC__JOIN(TF_CRC__P0, TF_CRC__P1, TF_CRC__P2, TF_CRC__P3)
+    #define TF_CRC__START TF_CRC__JOIN(TF_CRC__RBYTE(TF_CRC_INIT, 0), TF_CRC__RBYTE(TF_CRC_INIT, 1), \
+                                       TF_CRC__RBYTE(TF_CRC_INIT, 2), TF_CRC__RBYTE(TF_CRC_INIT, 3))
+#else
+    // Not reflected: the register shifts left, entry for bit 0 is the polynomial.
+    // Each higher bit's entry is the previous one shifted left by one bit and reduced.
+    enum {
+        TF_CRC__P0 = TF_CRC__BYTE(TF_CRC_POLY, 0),
+        TF_CRC__P1 = TF_CRC__BYTE(TF_CRC_POLY, 1),
+        TF_CRC__P2 = TF_CRC__BYTE(TF_CRC_POLY, 2),
+        TF_CRC__P3 = TF_CRC__BYTE(TF_CRC_POLY, 3),
+    };
+
+    #define TF_CRC__TOP(prev) (((prev##_0 * (TF_CRC__NBYTES == 1)) | (prev##_1 * (TF_CRC__NBYTES == 2)) | \
+                                (prev##_3 * (TF_CRC__NBYTES == 4))) >> 7)
+
+    #define TF_CRC__STEP(prev, next) \
+        next##_0 = (((prev##_0 << 1) & 0xFF) ^ (TF_CRC__TOP(prev) * TF_CRC__P0)), \
+        next##_1 = ((((prev##_1 << 1) | (prev##_0 >> 7)) & (0xFF * (TF_CRC__NBYTES > 1))) ^ (TF_CRC__TOP(prev) * TF_CRC__P1)), \
+        next##_2 = ((((prev##_2 << 1) | (prev##_1 >> 7)) & (0xFF * (TF_CRC__NBYTES > 2))) ^ (TF_CRC__TOP(prev) * TF_CRC__P2)), \
+        next##_3 = ((((prev##_3 << 1) | (prev##_2 >> 7)) & (0xFF * (TF_CRC__NBYTES > 3))) ^ (TF_CRC__TOP(prev) * TF_CRC__P3))
+
+    enum {
+        TF_CRC__B0_0 = TF_CRC__P0, TF_CRC__B0_1 = TF_CRC__P1, TF_CRC__B0_2 = TF_CRC__P2, TF_CRC__B0_3 = TF_CRC__P3,
+        TF_CRC__STEP(TF_CRC__B0, TF_CRC__B1),
+        TF_CRC__STEP(TF_CRC__B1, TF_CRC__B2),
+        TF_CRC__STEP(TF_CRC__B2, TF_CRC__B3),
+        TF_CRC__STEP(TF_CRC__B3, TF_CRC__B4),
+        TF_CRC__STEP(TF_CRC__B4, TF_CRC__B5),
+        TF_CRC__STEP(TF_CRC__B5, TF_CRC__B6),
+        TF_CRC__STEP(TF_CRC__B6, TF_CRC__B7),
+    };
+
+    #define TF_CRC__RPOLY TF_CRC__JOIN(TF_CRC__RBYTE(TF_CRC_POLY, 0), TF_CRC__RBYTE(TF_CRC_POLY, 1), \
+                                       TF_CRC__RBYTE(TF_CRC_POLY, 2), TF_CRC__RBYTE(TF_CRC_POLY, 3))
+    #define TF_CRC__START ((uint32_t) TF_CRC_INIT)
+#endif
+
+    #define TF_CRC__B(k) TF_CRC__JOIN(TF_CRC__B##k##_0, TF_CRC__B##k##_1, TF_CRC__B##k##_2, TF_CRC__B##k##_3)
+    #define TF_CRC__T1(n) (TF_CKSUM) ( \
+        (((n) & 0x01) ? TF_CRC__B(0) : 0) ^ (((n) & 0x02) ? TF_CRC__B(1) : 0) ^ \
+        (((n) & 0x04) ? TF_CRC__B(2) : 0) ^ (((n) & 0x08) ? TF_CRC__B(3) : 0) ^ \
+        (((n) & 0x10) ? TF_CRC__B(4) : 0) ^ (((n) & 0x20) ? TF_CRC__B(5) : 0) ^ \
+        (((n) & 0x40) ? TF_CRC__B(6) : 0) ^ (((n) & 0x80) ? TF_CRC__B(7) : 0))
+    #define TF_CRC__T4(n)  TF_CRC__T1(n), TF_CRC__T1((n) + 1), TF_CRC__T1((n) + 2), TF_CRC__T1((n) + 3)
+    #define TF_CRC__T16(n) TF_CRC__T4(n), TF_CRC__T4((n) + 4), TF_CRC__T4((n) + 8), TF_CRC__T4((n) + 12)
+    #define TF_CRC__T64(n) TF_CRC__T16(n), TF_CRC__T16((n) + 16), TF_CRC__T16((n) + 32), TF_CRC__T16((n) + 48)
+
+    static const TF_CKSUM crc_table[256] = {
+        TF_CRC__T64(0), TF_CRC__T64(64), TF_CRC__T64(128), TF_CRC__T64(192)
+    };
+
+    static TF_CKSUM TF_CksumStart(void)
+      { return (TF_CKSUM) TF_CRC__START; }
+
+#if TF_CRC_REFLECT
+    static TF_CKSUM TF_CksumAdd(TF_CKSUM cksum, uint8_t byte)
+      { return (TF_CKSUM) ((cksum >> 8) ^ crc_table[(cksum ^ byte) & 0xff]); }
+#else
+    static TF_CKSUM TF_CksumAdd(TF_CKSUM cksum, uint8_t byte)
+      { return (TF_CKSUM) ((cksum << 8) ^ crc_table[((cksum >> (TF_CRC_WIDTH - 8)) ^ byte) & 0xff]); }
+#endif
+
+    static TF_CKSUM TF_CksumEnd(TF_CKSUM cksum)
+      { return (TF_CKSUM) (cksum ^ TF_CRC_XOROUT); }
+
+#endif
+
+// CRC instructions of x86-64 CPUs, selected at run time
+#if defined(__GNUC__) && defined(__x86_64__)
+    #define TF_CKSUM_X86 1
+    #include <immintrin.h>
+#else
+    #define TF_CKSUM_X86 0
+#endif
+
+#if TF_CKSUM_X86 && (TF_CKSUM_TYPE == TF_CKSUM_CRC32C)
+    #define TF_CKSUM_USE_SSE42 1
+
+    /** Set by cksum_init_tables() if the CPU has the SSE4.2 crc32 instruction */
+    static bool crc32c_have_sse42 = false;
+
+    __attribute__((target("sse4.2")))
+    static TF_CKSUM crc32c_sse42(TF_CKSUM cksum, const uint8_t *buf, uint32_t len)
+    {
+        uint64_t crc = cksum;
+        uint64_t word;
+        while (len >= 8) {
+            memcpy(&word, buf, 8); // unaligned load
+            crc = _mm_crc32_u64(crc, word);
+            buf += 8;
+            len -= 8;
+        }
+        while (len-- > 0) {
+            crc = _mm_crc32_u8((uint32_t) crc, *buf++);
+        }
+        return (TF_CKSUM) crc;
+    }
+#endif
+
+#if TF_CKSUM_X86 && TF_CKSUM_CLMUL && ((TF_CKSUM_TYPE == TF_CKSUM_CRC16) || (TF_CKSUM_TYPE == TF_CKSUM_CRC32))
+    #define TF_CKSUM_USE_CLMUL 1
+
+    /** Set by cksum_init_tables() if the CPU has the PCLMULQDQ instruction */
+    static bool crc_have_clmul = false;
+
+    /**
+     * Folding constants for the reflected polynomial P, as in Intel's "Fast CRC Computation
+     * for Generic Polynomials Using PCLMULQDQ": k1..k5 are x^(512+32), x^(512-32), x^(128+32),
+     * x^(128-32) and x^64 mod P, followed by P and floor(x^64 / P) for the Barrett reduction.
+     * CRC16 is computed as a 32-bit CRC with P = 0x8005 * x^16, so it ends in the low half.
+     */
+#if TF_CKSUM_TYPE == TF_CKSUM_CRC32
+    static const uint64_t crc_fold_k[8] __attribute__((aligned(16))) = {
+        0x0154442bd4, 0x01c6e41596, 0x01751997d0, 0x00ccaa009e,
+        0x0163cd6124, 0,            0x01db710641, 0x01f7011641,
+    };
+#else
+    static const uint64_t crc_fold_k[8] __attribute__((aligned(16))) = {
+        0x000001b0c2, 0x000000bffa, 0x000001d0c2, 0x0000018cc2,
+        0x000001bc02, 0,            0x0000014003, 0x01cfffbfff,
+    };
+#endif
+
+    /**
+     * Fold a buffer into the CRC 64 bytes at a time using carry-less multiplication.
+     * The length must be at least 64 and a multiple of 16.
+     */
+    __attribute__((target("pclmul,sse4.1")))
+    static TF_CKSUM crc_fold_clmul(TF_CKSUM cksum, const uint8_t *buf, uint32_t len)
+    {
+        __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+        const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+        x1 = _mm_loadu_si128((const __m128i *) (buf + 0x00));
+        x2 = _mm_loadu_si128((const __m128i *) (buf + 0x10));
+        x3 = _mm_loadu_si128((const __m128i *) (buf + 0x20));
+        x4 = _mm_loadu_si128((const __m128i *) (buf + 0x30));
+        x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int) cksum));
+        buf += 64;
+        len -= 64;
+
+        // Fold 4x128 bits in parallel
+        x0 = _mm_load_si128((const __m128i *) &crc_fold_k[0]);
+        while (len >= 64) {
+            x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+            x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+            x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+            x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+            x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+            x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+            x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+            x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+            x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *) (buf + 0x00)));
+            x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *) (buf + 0x10)));
+            x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *) (buf + 0x20)));
+            x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *) (buf + 0x30)));
+            buf += 64;
+            len -= 64;
+        }
+
+        // Fold the 4 lanes into one
+        x0 = _mm_load_si128((const __m128i *) &crc_fold_k[2]);
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+        // Fold the remaining 128-bit blocks
+        while (len >= 16) {
+            x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+            x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+            x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *) buf));
+            buf += 16;
+            len -= 16;
+        }
+
+        // 128 -> 64 bits
+        x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+        x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+        x0 = _mm_loadl_epi64((const __m128i *) &crc_fold_k[4]);
+        x2 = _mm_srli_si128(x1, 4);
+        x1 = _mm_and_si128(x1, mask32);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_xor_si128(x1, x2);
+
+        // Barrett reduction to 32 bits
+        x0 = _mm_load_si128((const __m128i *) &crc_fold_k[6]);
+        x2 = _mm_and_si128(x1, mask32);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+        x2 = _mm_and_si128(x2, mask32);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x1 = _mm_xor_si128(x1, x2);
+
+        return (TF_CKSUM) _mm_extract_epi32(x1, 1);
+    }
+#endif
+
+#ifndef TF_CKSUM_HAVE_ADDBUF
+    /** Add a buffer of bytes to the checksum, using the fastest code available */
+    static inline TF_CKSUM TF_CksumAddBuf(TF_CKSUM cksum, const uint8_t *buf, uint32_t len)
+    {
+#if TF_CKSUM_USE_SSE42
+        if (crc32c_have_sse42) {
+            return crc32c_sse42(cksum, buf, len);
+        }
+#endif
+#if TF_CKSUM_USE_CLMUL
+        if (crc_have_clmul && len >= 64) {
+            uint32_t i = len & ~(uint32_t) 15;
+            cksum = crc_fold_clmul(cksum, buf, i);
+            buf += i;
+            len -= i;
+        }
+#endif
+#if TF_CKSUM_SLICED
+        return crc_add_sliced(cksum, buf, len);
+#else
+        {
+            uint32_t i;
+            for (i = 0; i < len; i++) {
+                cksum = TF_CksumAdd(cksum, buf[i]);
+            }
+        }
+        return cksum;
+#endif
+    }
+#endif
+
+/** Generate lookup tables and detect CPU features for the checksum, if needed */
+static void cksum_init_tables(void)
+{
+#if TF_CKSUM_SLICED
+    crc_slice_init();
+#endif
+#if TF_CKSUM_USE_SSE42 || TF_CKSUM_USE_CLMUL
+    __builtin_cpu_init();
+#endif
+#if TF_CKSUM_USE_SSE42
+    crc32c_have_sse42 = __builtin_cpu_supports("sse4.2");
+#endif
+#if TF_CKSUM_USE_CLMUL
+    crc_have_clmul = __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+#endif
+}
+
+#if TF_CKSUM_COMBINE
+
+// Reflected CRC polynomials, used to shift a CRC over a run of zero bytes
+#if TF_CKSUM_TYPE == TF_CKSUM_CRC8
+    #define TF_CKSUM_RPOLY 0x8Cu
+#elif TF_CKSUM_TYPE == TF_CKSUM_CRC16
+    #define TF_CKSUM_RPOLY 0xA001u
+#elif TF_CKSUM_TYPE == TF_CKSUM_CRC32
+    #define TF_CKSUM_RPOLY 0xEDB88320u
+#elif TF_CKSUM_TYPE == TF_CKSUM_CRC32C
+    #define TF_CKSUM_RPOLY 0x82F63B78u
+#elif TF_CKSUM_TYPE == TF_CKSUM_CRC
+    #define TF_CKSUM_RPOLY TF_CRC__RPOLY
+#endif
+
+#ifdef TF_CKSUM_RPOLY
+    /** Multiply two polynomials modulo the CRC polynomial. The top bit is x^0 (reflected order). */
+    static uint32_t cksum_mulmod(uint32_t a, uint32_t b)
+    {
+        uint32_t m = (uint32_t) 1 << (sizeof(TF_CKSUM) * 8 - 1);
+        uint32_t p = 0;
+
+        for (; m != 0; m >>= 1) {
+            if (a & m) {
+                p ^= b;
+                a ^= m;
+                if (a == 0) break;
+            }
+            b = (b & 1) ? (b >> 1) ^ TF_CKSUM_RPOLY : (b >> 1); // b *= x
+        }
+        return p;
+    }
+
+    /** Advance a CRC register as if 'len' zero bytes were added (multiply by x^(8*len)) */
+    static uint32_t cksum_shift(uint32_t cksum, uint32_t len)
+    {
+        uint32_t xn = (uint32_t) 1 << (sizeof(TF_CKSUM) * 8 - 1); // x^0
+        uint32_t sq;
+        uint8_t i;
+
+        // x^8 (done by repeated multiplication by x, so it works for 8-bit CRCs too)
+        sq = xn;
+        for (i = 0; i < 8; i++) {
+            sq = (sq & 1) ? (sq >> 1) ^ TF_CKSUM_RPOLY : (sq >> 1);
+        }
+
+        // square-and-multiply
+        while (len > 0) {
+            if (len & 1) xn = cksum_mulmod(xn, sq);
+            len >>= 1;
+            if (len > 0) sq = cksum_mulmod(sq, sq);
+        }
+        return cksum_mulmod(xn, cksum);
+    }
+#endif
+
+#if (TF_CKSUM_TYPE == TF_CKSUM_CRC) && !TF_CRC_REFLECT
+    /** Reverse the bits of a CRC register */
+    static uint32_t cksum_reflect(uint32_t cksum)
+    {
+        uint32_t r = 0;
+        uint8_t i;
+        for (i = 0; i < TF_CRC_WIDTH; i++) {
+            r = (r << 1) | (cksum & 1);
+            cksum >>= 1;
+        }
+        return r;
+    }
+#endif
+
+TF_CKSUM _TF_FN TF_CksumPartial(const uint8_t *buff, uint32_t length)
+{
+    return TF_CksumAddBuf(0, buff, length);
+}
+
+TF_CKSUM _TF_FN TF_CksumCombine(TF_CKSUM cksum1, TF_CKSUM cksum2, uint32_t length2)
+{
+#if (TF_CKSUM_TYPE == TF_CKSUM_CRC) && !TF_CRC_REFLECT
+    // The shift works in the reflected bit order, take the register there and back
+    return (TF_CKSUM) (cksum_reflect(cksum_shift(cksum_reflect(cksum1), length2)) ^ cksum2);
+#elif defined(TF_CKSUM_RPOLY)
+    return (TF_CKSUM) (cksum_shift(cksum1, length2) ^ cksum2);
+#else
+    // XOR needs no shifting, NONE is always 0
+    (void) length2;
+    return (TF_CKSUM) (cksum1 ^ cksum2);
 #endif
+}
+
+#endif // TF_CKSUM_COMBINE
 
 #define CKSUM_RESET(cksum)     do { (cksum) = TF_CksumStart(); } while (0)
 #define CKSUM_ADD(cksum, byte) do { (cksum) = TF_CksumAdd((cksum), (byte)); } while (0)
@@ -210,6 +800,15 @@
 
 //region Init
 
+// in the Listeners region
+static void _TF_FN listeners_init(TinyFrame *tf);
+#if TF_DYNAMIC_LISTENERS
+static void _TF_FN listeners_free(TinyFrame *tf);
+
+/** Value of .lst_mark in an initialized instance */
+#define TF_LST_MARK 0x54464C53u
+#endif
+
 /** Init with a user-allocated buffer */
 bool _TF_FN TF_InitStatic(TinyFrame *tf, TF_Peer peer_bit)
 {
@@ -218,6 +817,13 @@ bool _TF_FN TF_InitStatic(TinyFrame *tf, TF_Peer peer_bit)
         return false;
     }
 
+#if TF_DYNAMIC_LISTENERS
+    // Re-init: release the listeners of the previous run
+    if (tf->lst_mark == TF_LST_MARK) {
+        listeners_free(tf);
+    }
+#endif
+
     // Zero it out, keeping user config
     uint32_t usertag = tf->usertag;
     void * userdata = tf->userdata;
@@ -228,13 +834,17 @@ bool _TF_FN TF_InitStatic(TinyFrame *tf, TF_Peer peer_bit)
     tf->userdata = userdata;
 
     tf->peer_bit = peer_bit;
+    listeners_init(tf);
+
+    cksum_init_tables();
     return true;
 }
 
 /** Init with malloc */
 TinyFrame * _TF_FN TF_Init(TF_Peer peer_bit)
 {
-    TinyFrame *tf = malloc(sizeof(TinyFrame));
+    // zeroed, so TF_InitStatic() doesn't take it for an instance being re-initialized
+    TinyFrame *tf = calloc(1, sizeof(TinyFrame));
     if (!tf) {
         TF_Error("TF_Init() failed, out of memory.");
         return NULL;
@@ -248,160 +858,899 @@ TinyFrame * _TF_FN TF_Init(TF_Peer peer_bit)
 void TF_DeInit(TinyFrame *tf)
 {
     if (tf == NULL) return;
+    TF_DeInitStatic(tf);
     free(tf);
 }
 
+/** Release the listeners of a user-allocated instance */
+void TF_DeInitStatic(TinyFrame *tf)
+{
+    if (tf == NULL) return;
+#if TF_DYNAMIC_LISTENERS
+    if (tf->lst_mark == TF_LST_MARK) {
+        listeners_free(tf);
+        tf->lst_mark = 0;
+    }
+#endif
+}
+
 //endregion Init
 
 
 //region Listeners
 
-/** Reset ID listener's timeout to the original value */
-static inline void _TF_FN renew_id_listener(struct TF_IdListener_ *lst)
+/** Mix the bits of a listener key for the hashed index */
+static inline uint32_t _TF_FN index_hash(uint32_t key)
 {
-    lst->timeout = lst->timeout_max;
+    key *= 0x9E3779B1u;
+    return key ^ (key >> 16);
 }
 
-/** Notify callback about ID listener's demise & let it free any resources in userdata */
-static void _TF_FN cleanup_id_listener(TinyFrame *tf, TF_COUNT i, struct TF_IdListener_ *lst)
+/**
+ * Find a key in a listener index. The index holds slot + 1 of the first listener
+ * for each key (0 = empty).
+ *
+ * If keys is NULL, the key is the position (1-byte keys). Otherwise it's a hash table
+ * with linear probing, and the position returned is that of the key, or of the empty
+ * entry where it should be added.
+ *
+ * @param heads - index entries
+ * @param keys - key of each used entry, or NULL
+ * @param len - number of entries, a power of two
+ * @param key - key to look for
+ * @return position in the index
+ */
+static inline uint32_t _TF_FN index_find(const TF_COUNT *heads, const uint32_t *keys, uint32_t len, uint32_t key)
 {
-    TF_Msg msg;
-    if (lst->fn == NULL) return;
+    uint32_t pos;
+    if (keys == NULL) return key;
 
-    // Make user clean up their data - only if not NULL
-    if (lst->userdata != NULL || lst->userdata2 != NULL) {
-        msg.userdata = lst->userdata;
-        msg.userdata2 = lst->userdata2;
-        msg.data = NULL; // this is a signal that the listener should clean up
-        lst->fn(tf, &msg); // return value is ignored here - use TF_STAY or TF_CLOSE
+    pos = index_hash(key) & (len - 1);
+    while (heads[pos] != 0 && keys[pos] != key) {
+        pos = (pos + 1) & (len - 1);
     }
+    return pos;
+}
 
-    lst->fn = NULL; // Discard listener
-    lst->fn_timeout = NULL;
-
-    if (i == tf->count_id_lst - 1) {
-        tf->count_id_lst--;
+/** Clear a listener index entry. Entries after it are moved up so they can still be found. */
+static void _TF_FN index_clear(TF_COUNT *heads, uint32_t *keys, uint32_t len, uint32_t pos)
+{
+    uint32_t next, home;
+
+    heads[pos] = 0;
+    if (keys == NULL) return;
+
+    next = (pos + 1) & (len - 1);
+    while (heads[next] != 0) {
+        home = index_hash(keys[next]) & (len - 1);
+        // move the entry into the hole, unless its home position is between the hole and itself
+        if (((next - home) & (len - 1)) >= ((next - pos) & (len - 1))) {
+            heads[pos] = heads[next];
+            keys[pos] = keys[next];
+            heads[next] = 0;
+            pos = next;
+        }
+        next = (next + 1) & (len - 1);
     }
 }
 
-/** Clean up Type listener */
-static inline void _TF_FN cleanup_type_listener(TinyFrame *tf, TF_COUNT i, struct TF_TypeListener_ *lst)
+#if TF_DYNAMIC_LISTENERS
+
+#if TF_ID_BYTES != 1 || TF_TYPE_BYTES != 1
+/** Resize an index hash table, keeping its entries. Returns false if out of memory. */
+static bool _TF_FN index_resize(struct TF_Index_ *index, uint32_t len)
 {
-    lst->fn = NULL; // Discard listener
-    if (i == tf->count_type_lst - 1) {
-        tf->count_type_lst--;
+    TF_COUNT *heads = calloc(len, sizeof(TF_COUNT));
+    uint32_t *keys = malloc(len * sizeof(uint32_t));
+    uint32_t i, pos;
+
+    if (heads == NULL || keys == NULL) {
+        free(heads);
+        free(keys);
+        return false;
+    }
+
+    for (i = 0; i < index->len; i++) {
+        if (index->heads[i] == 0) continue;
+        pos = index_find(heads, keys, len, index->keys[i]);
+        heads[pos] = index->heads[i];
+        keys[pos] = index->keys[i];
     }
+
+    free(index->heads);
+    free(index->keys);
+    index->heads = heads;
+    index->keys = keys;
+    index->len = len;
+    return true;
 }
 
-/** Clean up Generic listener */
-static inline void _TF_FN cleanup_generic_listener(TinyFrame *tf, TF_COUNT i, struct TF_GenericListener_ *lst)
+/** Make sure an index hash table has room for another key. Returns false if out of memory. */
+static bool _TF_FN index_reserve(struct TF_Index_ *index)
 {
-    lst->fn = NULL; // Discard listener
-    if (i == tf->count_generic_lst - 1) {
-        tf->count_generic_lst--;
-    }
+    if ((index->used + 1) * 2 <= index->len) return true;
+    return index_resize(index, index->len ? index->len * 2 : 16);
 }
 
-/** Add a new ID listener. Returns 1 on success. */
-bool _TF_FN TF_AddIdListener(TinyFrame *tf, TF_Msg *msg, TF_Listener cb, TF_Listener_Timeout ftimeout, TF_TICKS timeout)
+/** Shrink an index hash table that is mostly empty */
+static void _TF_FN index_trim(struct TF_Index_ *index)
 {
-    TF_COUNT i;
-    struct TF_IdListener_ *lst;
-    for (i = 0; i < TF_MAX_ID_LST; i++) {
-        lst = &tf->id_listeners[i];
-        // test for empty slot
-        if (lst->fn == NULL) {
-            lst->fn = cb;
-            lst->fn_timeout = ftimeout;
-            lst->id = msg->frame_id;
-            lst->userdata = msg->userdata;
-            lst->userdata2 = msg->userdata2;
-            lst->timeout_max = lst->timeout = timeout;
-            if (i >= tf->count_id_lst) {
-                tf->count_id_lst = (TF_COUNT) (i + 1);
-            }
-            return true;
-        }
+    if (index->len > 16 && index->used * 8 < index->len) {
+        index_resize(index, index->len / 2); // keeps the larger table if this fails
     }
+}
 
-    TF_Error("Failed to add ID listener");
-    return false;
+/** Free an index hash table */
+static void _TF_FN index_free(struct TF_Index_ *index)
+{
+    free(index->heads);
+    free(index->keys);
+    memset(index, 0, sizeof(struct TF_Index_));
 }
+#endif
 
-/** Add a new Type listener. Returns 1 on success. */
-bool _TF_FN TF_AddTypeListener(TinyFrame *tf, TF_TYPE frame_type, TF_Listener cb)
+/** Get a listener slot from a pool */
+#define POOL_ITEM(pool, slot, type) \
+    ((type *) ((pool)->slabs[(slot) / TF_LISTENER_SLAB] + ((slot) % TF_LISTENER_SLAB) * sizeof(type)))
+
+/** Remove a slab from the list of slabs with free slots */
+static void _TF_FN pool_unlink(struct TF_Pool_ *pool, TF_COUNT s)
 {
-    TF_COUNT i;
-    struct TF_TypeListener_ *lst;
-    for (i = 0; i < TF_MAX_TYPE_LST; i++) {
-        lst = &tf->type_listeners[i];
-        // test for empty slot
-        if (lst->fn == NULL) {
-            lst->fn = cb;
-            lst->type = frame_type;
-            if (i >= tf->count_type_lst) {
-                tf->count_type_lst = (TF_COUNT) (i + 1);
-            }
-            return true;
-        }
-    }
+    struct TF_Slab_ *info = &pool->info[s];
 
-    TF_Error("Failed to add type listener");
-    return false;
+    if (info->prev != 0) {
+        pool->info[info->prev - 1].next = info->next;
+    } else {
+        pool->partial = info->next;
+    }
+    if (info->next != 0) {
+        pool->info[info->next - 1].prev = info->prev;
+    }
 }
 
-/** Add a new Generic listener. Returns 1 on success. */
-bool _TF_FN TF_AddGenericListener(TinyFrame *tf, TF_Listener cb)
+/** Add a slab to the list of slabs with free slots */
+static void _TF_FN pool_link(struct TF_Pool_ *pool, TF_COUNT s)
 {
-    TF_COUNT i;
-    struct TF_GenericListener_ *lst;
-    for (i = 0; i < TF_MAX_GEN_LST; i++) {
-        lst = &tf->generic_listeners[i];
-        // test for empty slot
-        if (lst->fn == NULL) {
-            lst->fn = cb;
-            if (i >= tf->count_generic_lst) {
-                tf->count_generic_lst = (TF_COUNT) (i + 1);
-            }
-            return true;
-        }
-    }
+    struct TF_Slab_ *info = &pool->info[s];
 
-    TF_Error("Failed to add generic listener");
-    return false;
+    info->prev = 0;
+    info->next = pool->partial;
+    if (info->next != 0) {
+        pool->info[info->next - 1].prev = (TF_COUNT) (s + 1);
+    }
+    pool->partial = (TF_COUNT) (s + 1);
 }
 
-/** Remove a ID listener by its frame ID. Returns 1 on success. */
-bool _TF_FN TF_RemoveIdListener(TinyFrame *tf, TF_ID frame_id)
+/** Allocate a slab of free slots. Returns false if out of memory, or if slot numbers wouldn't fit in TF_COUNT. */
+static bool _TF_FN pool_grow(struct TF_Pool_ *pool, size_t item_size)
 {
+    TF_COUNT s;
     TF_COUNT i;
-    struct TF_IdListener_ *lst;
-    for (i = 0; i < tf->count_id_lst; i++) {
-        lst = &tf->id_listeners[i];
-        // test if live & matching
-        if (lst->fn != NULL && lst->id == frame_id) {
-            cleanup_id_listener(tf, i, lst);
-            return true;
-        }
+    uint8_t **slabs;
+    struct TF_Slab_ *info;
+
+    // take the place of a released slab, or add one at the end
+    for (s = 0; s < pool->len && pool->slabs[s] != NULL; s++);
+
+    if (s == pool->len) {
+        // slot + 1 must fit in TF_COUNT
+        if ((uint32_t) (s + 1) * TF_LISTENER_SLAB > (TF_COUNT) ~(TF_COUNT) 0) return false;
+
+        slabs = realloc(pool->slabs, (s + 1) * sizeof(uint8_t *));
+        if (slabs == NULL) return false;
+        pool->slabs = slabs;
+
+        info = realloc(pool->info, (s + 1) * sizeof(struct TF_Slab_));
+        if (info == NULL) return false;
+        pool->info = info;
+
+        pool->slabs[s] = NULL;
+        pool->len = (TF_COUNT) (s + 1);
     }
 
-    TF_Error("ID listener %d to remove not found", (int)frame_id);
-    return false;
+    pool->slabs[s] = calloc(TF_LISTENER_SLAB, item_size);
+    if (pool->slabs[s] == NULL) return false;
+
+    info = &pool->info[s];
+    info->live = 0;
+    info->free = 1;
+    for (i = 0; i < TF_LISTENER_SLAB; i++) {
+        info->link[i] = (TF_COUNT) (i + 1 < TF_LISTENER_SLAB ? i + 2 : 0);
+    }
+    pool_link(pool, s);
+    pool->empty++;
+    return true;
 }
 
-/** Remove a type listener by its type. Returns 1 on success. */
-bool _TF_FN TF_RemoveTypeListener(TinyFrame *tf, TF_TYPE type)
+/** Take a free slot from a pool. Returns slot + 1, 0 if out of memory. */
+static TF_COUNT _TF_FN pool_alloc(struct TF_Pool_ *pool, size_t item_size)
 {
+    TF_COUNT s;
     TF_COUNT i;
-    struct TF_TypeListener_ *lst;
-    for (i = 0; i < tf->count_type_lst; i++) {
-        lst = &tf->type_listeners[i];
-        // test if live & matching
-        if (lst->fn != NULL    && lst->type == type) {
-            cleanup_type_listener(tf, i, lst);
-            return true;
+    struct TF_Slab_ *info;
+
+    if (pool->partial == 0 && !pool_grow(pool, item_size)) return 0;
+
+    s = (TF_COUNT) (pool->partial - 1);
+    info = &pool->info[s];
+    i = (TF_COUNT) (info->free - 1);
+
+    info->free = info->link[i];
+    if (info->free == 0) {
+        pool_unlink(pool, s);
+    }
+    if (info->live++ == 0) {
+        pool->empty--;
+    }
+    return (TF_COUNT) (s * TF_LISTENER_SLAB + i + 1);
+}
+
+/** Return a slot to its pool */
+static void _TF_FN pool_free(struct TF_Pool_ *pool, TF_COUNT slot)
+{
+    TF_COUNT s = (TF_COUNT) (slot / TF_LISTENER_SLAB);
+    TF_COUNT i = (TF_COUNT) (slot % TF_LISTENER_SLAB);
+    struct TF_Slab_ *info = &pool->info[s];
+
+    if (info->free == 0) {
+        pool_link(pool, s);
+    }
+    info->link[i] = info->free;
+    info->free = (TF_COUNT) (i + 1);
+    if (--info->live == 0) {
+        pool->empty++;
+    }
+}
+
+/** Release empty slabs, keeping one for the next listeners */
+static void _TF_FN pool_trim(struct TF_Pool_ *pool)
+{
+    TF_COUNT s = pool->len;
+
+    while (pool->empty > 1 && s > 0) {
+        s--;
+        if (pool->slabs[s] == NULL || pool->info[s].live != 0) continue;
+
+        pool_unlink(pool, s);
+        free(pool->slabs[s]);
+        pool->slabs[s] = NULL;
+        pool->empty--;
+    }
+
+    while (pool->len > 0 && pool->slabs[pool->len - 1] == NULL) {
+        pool->len--;
+    }
+}
+
+/** Free all slabs of a pool */
+static void _TF_FN pool_free_all(struct TF_Pool_ *pool)
+{
+    TF_COUNT s;
+
+    for (s = 0; s < pool->len; s++) {
+        free(pool->slabs[s]);
+    }
+    free(pool->slabs);
+    free(pool->info);
+    memset(pool, 0, sizeof(struct TF_Pool_));
+}
+
+/** Free all listener memory */
+static void _TF_FN listeners_free(TinyFrame *tf)
+{
+    pool_free_all(&tf->id_pool);
+    pool_free_all(&tf->type_pool);
+    free(tf->generic_listeners);
+    tf->generic_listeners = NULL;
+    tf->generic_cap = 0;
+#if TF_ID_BYTES != 1
+    index_free(&tf->id_index);
+#endif
+#if TF_TYPE_BYTES != 1
+    index_free(&tf->type_index);
+#endif
+}
+
+#define ID_LST(tf, slot) POOL_ITEM(&(tf)->id_pool, slot, struct TF_IdListener_)
+#define TYPE_LST(tf, slot) POOL_ITEM(&(tf)->type_pool, slot, struct TF_TypeListener_)
+
+#else
+
+#define ID_LST(tf, slot) (&(tf)->id_listeners[slot])
+#define TYPE_LST(tf, slot) (&(tf)->type_listeners[slot])
+
+#endif // TF_DYNAMIC_LISTENERS
+
+#define GENERIC_LST(tf, i) (&(tf)->generic_listeners[i])
+
+/** Chain all listener slots into the free lists */
+static void _TF_FN listeners_init(TinyFrame *tf)
+{
+#if TF_DYNAMIC_LISTENERS
+    tf->lst_mark = TF_LST_MARK;
+#else
+    TF_COUNT i;
+
+    for (i = 0; i < TF_MAX_ID_LST; i++) {
+        tf->id_listeners[i].next = (TF_COUNT) (i + 1 < TF_MAX_ID_LST ? i + 2 : 0);
+    }
+    tf->id_free = 1;
+
+    for (i = 0; i < TF_MAX_TYPE_LST; i++) {
+        tf->type_listeners[i].next = (TF_COUNT) (i + 1 < TF_MAX_TYPE_LST ? i + 2 : 0);
+    }
+    tf->type_free = 1;
+#endif
+}
+
+static void _TF_FN id_lst_reap(TinyFrame *tf);
+
+/**
+ * Remove the holes left by removed generic listeners, release ID listeners removed
+ * during callbacks, and release unused listener memory. This waits until no listener
+ * callbacks are running.
+ */
+static void _TF_FN listeners_tidy(TinyFrame *tf)
+{
+    TF_COUNT i;
+    TF_COUNT n = 0;
+#if TF_DYNAMIC_LISTENERS
+    struct TF_GenericListener_ *lsts;
+#endif
+
+    if (tf->lst_busy != 0) return;
+
+    if (tf->generic_holes) {
+        for (i = 0; i < tf->count_generic_lst; i++) {
+            if (GENERIC_LST(tf, i)->fn != NULL) {
+                *GENERIC_LST(tf, n++) = *GENERIC_LST(tf, i);
+            }
+        }
+        tf->count_generic_lst = n;
+        tf->generic_holes = false;
+    }
+
+    id_lst_reap(tf);
+
+#if TF_DYNAMIC_LISTENERS
+    pool_trim(&tf->id_pool);
+    pool_trim(&tf->type_pool);
+
+    if (tf->generic_cap > 4 && tf->count_generic_lst * 4 < tf->generic_cap) {
+        lsts = realloc(tf->generic_listeners, (tf->generic_cap / 2) * sizeof(struct TF_GenericListener_));
+        if (lsts != NULL) {
+            tf->generic_listeners = lsts;
+            tf->generic_cap = (TF_COUNT) (tf->generic_cap / 2);
         }
     }
+#endif
+}
+
+/** Mark that listener callbacks are running - listeners must stay where they are */
+static inline void _TF_FN listeners_hold(TinyFrame *tf)
+{
+    tf->lst_busy++;
+}
+
+/** Counterpart to listeners_hold() */
+static inline void _TF_FN listeners_unhold(TinyFrame *tf)
+{
+    tf->lst_busy--;
+    listeners_tidy(tf);
+}
+
+#if TF_ID_BYTES == 1
+    #define ID_INDEX_HEADS(tf) ((tf)->id_index)
+    #define ID_INDEX_KEYS(tf) NULL
+    #define ID_INDEX_LEN(tf) TF_ID_INDEX_LEN
+#elif TF_DYNAMIC_LISTENERS
+    #define ID_INDEX_DYNAMIC 1
+    #define ID_INDEX_HEADS(tf) ((tf)->id_index.heads)
+    #define ID_INDEX_KEYS(tf) ((tf)->id_index.keys)
+    #define ID_INDEX_LEN(tf) ((tf)->id_index.len)
+#else
+    #define ID_INDEX_HEADS(tf) ((tf)->id_index)
+    #define ID_INDEX_KEYS(tf) ((tf)->id_index_key)
+    #define ID_INDEX_LEN(tf) TF_ID_INDEX_LEN
+#endif
+
+/** Get the first ID listener for a frame ID (slot + 1, 0 = none) */
+static inline TF_COUNT _TF_FN id_index_first(TinyFrame *tf, TF_ID id)
+{
+#if ID_INDEX_DYNAMIC
+    if (tf->id_index.len == 0) return 0;
+#endif
+    return ID_INDEX_HEADS(tf)[index_find(ID_INDEX_HEADS(tf), ID_INDEX_KEYS(tf), ID_INDEX_LEN(tf), id)];
+}
+
+/** Get the first ID listener for a frame ID that wasn't removed during callbacks (slot + 1, 0 = none) */
+static inline TF_COUNT _TF_FN id_index_live(TinyFrame *tf, TF_ID id)
+{
+    TF_COUNT slot = id_index_first(tf, id);
+
+    while (slot != 0 && ID_LST(tf, slot - 1)->fn == NULL) {
+        slot = ID_LST(tf, slot - 1)->next;
+    }
+    return slot;
+}
+
+/**
+ * Add an ID listener to the index, before any others for the same ID - the
+ * latest query for a frame ID gets the response, also when an older listener
+ * for the same ID is left over from before the IDs wrapped around.
+ */
+static void _TF_FN id_index_add(TinyFrame *tf, TF_COUNT slot)
+{
+    TF_ID id = ID_LST(tf, slot)->id;
+    uint32_t pos = index_find(ID_INDEX_HEADS(tf), ID_INDEX_KEYS(tf), ID_INDEX_LEN(tf), id);
+    TF_COUNT *link = &ID_INDEX_HEADS(tf)[pos];
+
+#if TF_ID_BYTES != 1
+    ID_INDEX_KEYS(tf)[pos] = id;
+#endif
+#if ID_INDEX_DYNAMIC
+    if (*link == 0) tf->id_index.used++;
+#endif
+    ID_LST(tf, slot)->next = *link;
+    *link = (TF_COUNT) (slot + 1);
+}
+
+/** Remove an ID listener from the index */
+static void _TF_FN id_index_remove(TinyFrame *tf, TF_COUNT slot)
+{
+    uint32_t pos;
+    TF_COUNT *link;
+
+#if ID_INDEX_DYNAMIC
+    if (tf->id_index.len == 0) return;
+#endif
+    pos = index_find(ID_INDEX_HEADS(tf), ID_INDEX_KEYS(tf), ID_INDEX_LEN(tf), ID_LST(tf, slot)->id);
+    link = &ID_INDEX_HEADS(tf)[pos];
+
+    while (*link != 0 && *link != slot + 1) {
+        link = &ID_LST(tf, *link - 1)->next;
+    }
+    if (*link == 0) return; // not indexed
+
+    *link = ID_LST(tf, slot)->next;
+    if (ID_INDEX_HEADS(tf)[pos] == 0) {
+        index_clear(ID_INDEX_HEADS(tf), ID_INDEX_KEYS(tf), ID_INDEX_LEN(tf), pos);
+#if ID_INDEX_DYNAMIC
+        tf->id_index.used--;
+        index_trim(&tf->id_index);
+#endif
+    }
+}
+
+#if TF_TYPE_BYTES == 1
+    #define TYPE_INDEX_HEADS(tf) ((tf)->type_index)
+    #define TYPE_INDEX_KEYS(tf) NULL
+    #define TYPE_INDEX_LEN(tf) TF_TYPE_INDEX_LEN
+#elif TF_DYNAMIC_LISTENERS
+    #define TYPE_INDEX_DYNAMIC 1
+    #define TYPE_INDEX_HEADS(tf) ((tf)->type_index.heads)
+    #define TYPE_INDEX_KEYS(tf) ((tf)->type_index.keys)
+    #define TYPE_INDEX_LEN(tf) ((tf)->type_index.len)
+#else
+    #define TYPE_INDEX_HEADS(tf) ((tf)->type_index)
+    #define TYPE_INDEX_KEYS(tf) ((tf)->type_index_key)
+    #define TYPE_INDEX_LEN(tf) TF_TYPE_INDEX_LEN
+#endif
+
+/** Get the first type listener for a frame type (slot + 1, 0 = none) */
+static inline TF_COUNT _TF_FN type_index_first(TinyFrame *tf, TF_TYPE type)
+{
+#if TYPE_INDEX_DYNAMIC
+    if (tf->type_index.len == 0) return 0;
+#endif
+    return TYPE_INDEX_HEADS(tf)[index_find(TYPE_INDEX_HEADS(tf), TYPE_INDEX_KEYS(tf), TYPE_INDEX_LEN(tf), type)];
+}
+
+/** Add a type listener to the index, after any others for the same type */
+static void _TF_FN type_index_add(TinyFrame *tf, TF_COUNT slot)
+{
+    TF_TYPE type = TYPE_LST(tf, slot)->type;
+    uint32_t pos = index_find(TYPE_INDEX_HEADS(tf), TYPE_INDEX_KEYS(tf), TYPE_INDEX_LEN(tf), type);
+    TF_COUNT *link = &TYPE_INDEX_HEADS(tf)[pos];
+
+#if TF_TYPE_BYTES != 1
+    TYPE_INDEX_KEYS(tf)[pos] = type;
+#endif
+#if TYPE_INDEX_DYNAMIC
+    if (*link == 0) tf->type_index.used++;
+#endif
+    while (*link != 0) {
+        link = &TYPE_LST(tf, *link - 1)->next;
+    }
+    *link = (TF_COUNT) (slot + 1);
+    TYPE_LST(tf, slot)->next = 0;
+}
+
+/** Remove a type listener from the index */
+static void _TF_FN type_index_remove(TinyFrame *tf, TF_COUNT slot)
+{
+    uint32_t pos;
+    TF_COUNT *link;
+
+#if TYPE_INDEX_DYNAMIC
+    if (tf->type_index.len == 0) return;
+#endif
+    pos = index_find(TYPE_INDEX_HEADS(tf), TYPE_INDEX_KEYS(tf), TYPE_INDEX_LEN(tf), TYPE_LST(tf, slot)->type);
+    link = &TYPE_INDEX_HEADS(tf)[pos];
+
+    while (*link != 0 && *link != slot + 1) {
+        link = &TYPE_LST(tf, *link - 1)->next;
+    }
+    if (*link == 0) return; // not indexed
+
+    *link = TYPE_LST(tf, slot)->next;
+    if (TYPE_INDEX_HEADS(tf)[pos] == 0) {
+        index_clear(TYPE_INDEX_HEADS(tf), TYPE_INDEX_KEYS(tf), TYPE_INDEX_LEN(tf), pos);
+#if TYPE_INDEX_DYNAMIC
+        tf->type_index.used--;
+        index_trim(&tf->type_index);
+#endif
+    }
+}
+
+// ID listener timeouts are kept in a hierarchical timer wheel (see TF_TW_LEVELS). Level 0
+// has a bucket for each of the next 16 ticks. A listener expiring later goes to the lowest
+// level that spans its expiry tick, and is moved down when the bucket's time comes. A tick
+// thus only visits listeners that expire in it, or that are moved to a lower level.
+
+#define TW_MASK (TF_TW_SIZE - 1)
+#define TW_EXPIRING (TF_TW_LEVELS * TF_TW_SIZE) // bucket of listeners being expired
+#define TW_NONE 0xFF // tw_bucket of a listener that isn't scheduled
+
+/** Link an ID listener into a timer wheel bucket */
+static void _TF_FN tw_link(TinyFrame *tf, TF_COUNT slot, uint8_t bucket)
+{
+    struct TF_IdListener_ *lst = ID_LST(tf, slot);
+
+    lst->tw_bucket = bucket;
+    lst->tw_prev = 0;
+    lst->tw_next = tf->tw_buckets[bucket];
+    if (lst->tw_next != 0) {
+        ID_LST(tf, lst->tw_next - 1)->tw_prev = (TF_COUNT) (slot + 1);
+    }
+    tf->tw_buckets[bucket] = (TF_COUNT) (slot + 1);
+}
+
+/** Unlink an ID listener from its timer wheel bucket, if it's in one */
+static void _TF_FN tw_unlink(TinyFrame *tf, TF_COUNT slot)
+{
+    struct TF_IdListener_ *lst = ID_LST(tf, slot);
+
+    if (lst->tw_bucket == TW_NONE) return;
+
+    if (lst->tw_prev != 0) {
+        ID_LST(tf, lst->tw_prev - 1)->tw_next = lst->tw_next;
+    } else {
+        tf->tw_buckets[lst->tw_bucket] = lst->tw_next;
+    }
+    if (lst->tw_next != 0) {
+        ID_LST(tf, lst->tw_next - 1)->tw_prev = lst->tw_prev;
+    }
+    lst->tw_bucket = TW_NONE;
+}
+
+/**
+ * Put an ID listener in the timer wheel bucket for its expiry tick
+ *
+ * @param base - the next tick TF_Tick() will process
+ */
+static void _TF_FN tw_schedule(TinyFrame *tf, TF_COUNT slot, uint32_t base)
+{
+    uint32_t expires = ID_LST(tf, slot)->expires;
+    uint32_t delta = expires - base;
+    uint8_t level = 0;
+
+    while (level < TF_TW_LEVELS - 1 && delta >= ((uint32_t) 1 << (TF_TW_BITS * (level + 1)))) {
+        level++;
+    }
+
+    tw_link(tf, slot, (uint8_t) (level * TF_TW_SIZE + ((expires >> (TF_TW_BITS * level)) & TW_MASK)));
+}
+
+/** Move listeners from a bucket of a higher level to the levels below */
+static void _TF_FN tw_cascade(TinyFrame *tf, uint8_t bucket)
+{
+    TF_COUNT slot = tf->tw_buckets[bucket];
+    TF_COUNT next;
+
+    tf->tw_buckets[bucket] = 0;
+    while (slot != 0) {
+        next = ID_LST(tf, slot - 1)->tw_next;
+        tw_schedule(tf, (TF_COUNT) (slot - 1), tf->ticks);
+        slot = next;
+    }
+}
+
+/**
+ * Find the next tick at which the timer wheel has work - a level 0 bucket to expire,
+ * or a bucket of a higher level to move down. Ticks before it can be skipped.
+ *
+ * @param soonest - if not NULL, the number of ticks until the earliest listener
+ *                  expiry is stored here (0 if there's none)
+ * @return number of ticks until the next event, 0 if no listener is scheduled
+ */
+static uint32_t _TF_FN tw_next_event(TinyFrame *tf, uint32_t *soonest)
+{
+    uint32_t next = 0;
+    uint32_t digit;
+    uint32_t until;
+    uint8_t level;
+    uint8_t i;
+    TF_COUNT slot;
+
+    if (soonest != NULL) *soonest = 0;
+
+    for (level = 0; level < TF_TW_LEVELS; level++) {
+        // buckets of the level in the order their time comes, the current one is a full turn away
+        for (i = 1; i <= TF_TW_SIZE; i++) {
+            digit = (tf->ticks >> (TF_TW_BITS * level)) + i;
+            slot = tf->tw_buckets[level * TF_TW_SIZE + (digit & TW_MASK)];
+            if (slot == 0) continue;
+
+            until = (digit << (TF_TW_BITS * level)) - tf->ticks;
+            if (next == 0 || until < next) {
+                next = until;
+            }
+
+            // the earliest listener of the level is in its first used bucket
+            for (; soonest != NULL && slot != 0; slot = ID_LST(tf, slot - 1)->tw_next) {
+                until = ID_LST(tf, slot - 1)->expires - tf->ticks;
+                if (*soonest == 0 || until < *soonest) {
+                    *soonest = until;
+                }
+            }
+            break;
+        }
+    }
+    return next;
+}
+
+/** Reset ID listener's timeout to the original value */
+static void _TF_FN renew_id_listener(TinyFrame *tf, TF_COUNT slot)
+{
+    struct TF_IdListener_ *lst = ID_LST(tf, slot);
+
+    tw_unlink(tf, slot);
+    if (lst->timeout_max != 0) {
+        lst->expires = tf->ticks + lst->timeout_max;
+        tw_schedule(tf, slot, tf->ticks + 1);
+    }
+}
+
+/** Find a free ID listener slot. Returns false if there's none. */
+static bool _TF_FN id_lst_alloc(TinyFrame *tf, TF_COUNT *slot)
+{
+#if TF_DYNAMIC_LISTENERS
+    TF_COUNT s;
+#if ID_INDEX_DYNAMIC
+    if (!index_reserve(&tf->id_index)) return false;
+#endif
+    s = pool_alloc(&tf->id_pool, sizeof(struct TF_IdListener_));
+    if (s == 0) return false;
+    *slot = (TF_COUNT) (s - 1);
+#else
+    if (tf->id_free == 0) return false;
+    *slot = (TF_COUNT) (tf->id_free - 1);
+    tf->id_free = tf->id_listeners[*slot].next;
+#endif
+    tf->count_id_lst++;
+    return true;
+}
+
+/** Return an ID listener slot to the free list */
+static void _TF_FN id_lst_release(TinyFrame *tf, TF_COUNT slot)
+{
+#if TF_DYNAMIC_LISTENERS
+    pool_free(&tf->id_pool, slot);
+#else
+    tf->id_listeners[slot].next = tf->id_free;
+    tf->id_free = (TF_COUNT) (slot + 1);
+#endif
+    tf->count_id_lst--;
+}
+
+/** Unindex and release the ID listeners that were removed while callbacks ran */
+static void _TF_FN id_lst_reap(TinyFrame *tf)
+{
+    TF_COUNT slot;
+
+    while (tf->id_dead != 0) {
+        slot = (TF_COUNT) (tf->id_dead - 1);
+        tf->id_dead = ID_LST(tf, slot)->tw_next;
+        id_index_remove(tf, slot);
+        id_lst_release(tf, slot);
+    }
+}
+
+/** Find a free type listener slot. Returns false if there's none. */
+static bool _TF_FN type_lst_alloc(TinyFrame *tf, TF_COUNT *slot)
+{
+#if TF_DYNAMIC_LISTENERS
+    TF_COUNT s;
+#if TYPE_INDEX_DYNAMIC
+    if (!index_reserve(&tf->type_index)) return false;
+#endif
+    s = pool_alloc(&tf->type_pool, sizeof(struct TF_TypeListener_));
+    if (s == 0) return false;
+    *slot = (TF_COUNT) (s - 1);
+#else
+    if (tf->type_free == 0) return false;
+    *slot = (TF_COUNT) (tf->type_free - 1);
+    tf->type_free = tf->type_listeners[*slot].next;
+#endif
+    tf->count_type_lst++;
+    return true;
+}
+
+/** Return a type listener slot to the free list */
+static void _TF_FN type_lst_release(TinyFrame *tf, TF_COUNT slot)
+{
+#if TF_DYNAMIC_LISTENERS
+    pool_free(&tf->type_pool, slot);
+#else
+    tf->type_listeners[slot].next = tf->type_free;
+    tf->type_free = (TF_COUNT) (slot + 1);
+#endif
+    tf->count_type_lst--;
+}
+
+/** Make room for a generic listener at the end of the table. Returns false if there's none. */
+static bool _TF_FN generic_lst_reserve(TinyFrame *tf)
+{
+#if TF_DYNAMIC_LISTENERS
+    struct TF_GenericListener_ *lsts;
+    uint32_t cap;
+
+    if (tf->count_generic_lst < tf->generic_cap) return true;
+
+    cap = tf->generic_cap ? tf->generic_cap * 2u : 4u;
+    if (cap > (TF_COUNT) ~(TF_COUNT) 0) {
+        cap = (TF_COUNT) ~(TF_COUNT) 0;
+        if (cap == tf->generic_cap) return false;
+    }
+
+    lsts = realloc(tf->generic_listeners, cap * sizeof(struct TF_GenericListener_));
+    if (lsts == NULL) return false;
+    tf->generic_listeners = lsts;
+    tf->generic_cap = (TF_COUNT) cap;
+    return true;
+#else
+    return tf->count_generic_lst < TF_MAX_GEN_LST;
+#endif
+}
+
+/** Notify callback about ID listener's demise & let it free any resources in userdata */
+static void _TF_FN cleanup_id_listener(TinyFrame *tf, TF_COUNT i, struct TF_IdListener_ *lst)
+{
+    TF_Msg msg;
+    TF_Listener fn = lst->fn;
+    bool busy = tf->lst_busy != 0;
+    if (fn == NULL) return;
+
+    msg.userdata = lst->userdata;
+    msg.userdata2 = lst->userdata2;
+
+    // Discard the listener before calling the user, the callback may add or remove
+    // listeners (even this one). The slot is released after it, so it's not reused.
+    // While callbacks run, it stays in the index - a dispatch may be walking through
+    // it - and is unindexed and released by listeners_tidy().
+    if (!busy) id_index_remove(tf, i);
+    tw_unlink(tf, i);
+    lst->fn = NULL;
+    lst->fn_timeout = NULL;
+
+    // Make user clean up their data - only if not NULL
+    if (msg.userdata != NULL || msg.userdata2 != NULL) {
+        msg.data = NULL; // this is a signal that the listener should clean up
+        fn(tf, &msg); // return value is ignored here - use TF_STAY or TF_CLOSE
+    }
+
+    if (busy) {
+        ID_LST(tf, i)->tw_next = tf->id_dead; // not in the timer wheel any more
+        tf->id_dead = (TF_COUNT) (i + 1);
+    } else {
+        id_lst_release(tf, i);
+    }
+    listeners_tidy(tf);
+}
+
+/** Clean up Type listener */
+static inline void _TF_FN cleanup_type_listener(TinyFrame *tf, TF_COUNT i, struct TF_TypeListener_ *lst)
+{
+    if (lst->fn == NULL) return;
+
+    type_index_remove(tf, i);
+    lst->fn = NULL; // Discard listener
+    type_lst_release(tf, i);
+    listeners_tidy(tf);
+}
+
+/** Clean up Generic listener. The following ones are moved up when no callbacks are running. */
+static inline void _TF_FN cleanup_generic_listener(TinyFrame *tf, TF_COUNT i)
+{
+    GENERIC_LST(tf, i)->fn = NULL; // Discard listener
+    tf->generic_holes = true;
+    listeners_tidy(tf);
+}
+
+/** Add a new ID listener. Returns 1 on success. */
+bool _TF_FN TF_AddIdListener(TinyFrame *tf, TF_Msg *msg, TF_Listener cb, TF_Listener_Timeout ftimeout, TF_TICKS timeout)
+{
+    TF_COUNT i;
+    struct TF_IdListener_ *lst;
+    if (id_lst_alloc(tf, &i)) {
+        lst = ID_LST(tf, i);
+        lst->fn = cb;
+        lst->fn_timeout = ftimeout;
+        lst->id = msg->frame_id;
+        lst->userdata = msg->userdata;
+        lst->userdata2 = msg->userdata2;
+        lst->timeout_max = timeout;
+        lst->tw_bucket = TW_NONE;
+        id_index_add(tf, i);
+        renew_id_listener(tf, i);
+        return true;
+    }
+
+    TF_Error("Failed to add ID listener");
+    return false;
+}
+
+/** Add a new Type listener. Returns 1 on success. */
+bool _TF_FN TF_AddTypeListener(TinyFrame *tf, TF_TYPE frame_type, TF_Listener cb)
+{
+    TF_COUNT i;
+    struct TF_TypeListener_ *lst;
+    if (type_lst_alloc(tf, &i)) {
+        lst = TYPE_LST(tf, i);
+        lst->fn = cb;
+        lst->type = frame_type;
+        type_index_add(tf, i);
+        return true;
+    }
+
+    TF_Error("Failed to add type listener");
+    return false;
+}
+
+/** Add a new Generic listener. Returns 1 on success. */
+bool _TF_FN TF_AddGenericListener(TinyFrame *tf, TF_Listener cb)
+{
+    if (generic_lst_reserve(tf)) {
+        GENERIC_LST(tf, tf->count_generic_lst++)->fn = cb;
+        return true;
+    }
+
+    TF_Error("Failed to add generic listener");
+    return false;
+}
+
+/** Remove a ID listener by its frame ID. Returns 1 on success. */
+bool _TF_FN TF_RemoveIdListener(TinyFrame *tf, TF_ID frame_id)
+{
+    TF_COUNT slot = id_index_live(tf, frame_id);
+    if (slot != 0) {
+        cleanup_id_listener(tf, (TF_COUNT) (slot - 1), ID_LST(tf, slot - 1));
+        return true;
+    }
+
+    TF_Error("ID listener %d to remove not found", (int)frame_id);
+    return false;
+}
+
+/** Remove a type listener by its type. Returns 1 on success. */
+bool _TF_FN TF_RemoveTypeListener(TinyFrame *tf, TF_TYPE type)
+{
+    TF_COUNT slot = type_index_first(tf, type);
+    if (slot != 0) {
+        cleanup_type_listener(tf, (TF_COUNT) (slot - 1), TYPE_LST(tf, slot - 1));
+        return true;
+    }
 
     TF_Error("Type listener %d to remove not found", (int)type);
     return false;
@@ -411,12 +1760,10 @@ bool _TF_FN TF_RemoveTypeListener(TinyFrame *tf, TF_TYPE type)
 bool _TF_FN TF_RemoveGenericListener(TinyFrame *tf, TF_Listener cb)
 {
     TF_COUNT i;
-    struct TF_GenericListener_ *lst;
     for (i = 0; i < tf->count_generic_lst; i++) {
-        lst = &tf->generic_listeners[i];
         // test if live & matching
-        if (lst->fn == cb) {
-            cleanup_generic_listener(tf, i, lst);
+        if (cb != NULL && GENERIC_LST(tf, i)->fn == cb) {
+            cleanup_generic_listener(tf, i);
             return true;
         }
     }
@@ -425,10 +1772,83 @@ bool _TF_FN TF_RemoveGenericListener(TinyFrame *tf, TF_Listener cb)
     return false;
 }
 
-/** Handle a message that was just collected & verified by the parser */
-static void _TF_FN TF_HandleReceivedMessage(TinyFrame *tf)
+#if TF_USE_FRAGMENTS
+/** Read a number from a fragment header (big endian, like the frame fields) */
+static uint32_t _TF_FN frag_readnum(const uint8_t *buf, uint8_t bytes)
+{
+    uint32_t num = 0;
+    while (bytes-- > 0) {
+        num = (num << 8) | *buf++;
+    }
+    return num;
+}
+
+/**
+ * Add a received fragment to the message being reassembled
+ *
+ * @param tf - instance
+ * @param msg - the fragment. When it completes the message, replaced by the whole message.
+ * @return true if the message is complete
+ */
+static bool _TF_FN frag_accept(TinyFrame *tf, TF_Msg *msg)
+{
+    TF_TYPE type;
+    TF_LEN total;
+    TF_LEN offset;
+    TF_LEN chunk;
+
+    if (msg->len < TF_FRAG_HEAD_BYTES) {
+        TF_Error("Fragment too short");
+        return false;
+    }
+
+    type = (TF_TYPE) frag_readnum(msg->data, TF_TYPE_BYTES);
+    total = (TF_LEN) frag_readnum(msg->data + TF_TYPE_BYTES, TF_LEN_BYTES);
+    offset = (TF_LEN) frag_readnum(msg->data + TF_TYPE_BYTES + TF_LEN_BYTES, TF_LEN_BYTES);
+    chunk = (TF_LEN) (msg->len - TF_FRAG_HEAD_BYTES);
+
+    if (offset == 0) {
+        // First fragment, drop any unfinished message
+        if (total > TF_FRAG_MAX_RX) {
+            TF_Error("Fragmented message too long: %d", (int) total);
+            tf->frag_active = false;
+            return false;
+        }
+        tf->frag_active = true;
+        tf->frag_id = msg->frame_id;
+        tf->frag_type = type;
+        tf->frag_len = total;
+        tf->frag_pos = 0;
+    }
+    else if (!tf->frag_active || msg->frame_id != tf->frag_id || offset != tf->frag_pos) {
+        TF_Error("Fragment out of order, message dropped");
+        tf->frag_active = false;
+        return false;
+    }
+
+    if (chunk > tf->frag_len - tf->frag_pos) {
+        TF_Error("Fragment exceeds the message length");
+        tf->frag_active = false;
+        return false;
+    }
+
+    memcpy(tf->frag_buf + tf->frag_pos, msg->data + TF_FRAG_HEAD_BYTES, chunk);
+    tf->frag_pos += chunk;
+    if (tf->frag_pos < tf->frag_len) return false;
+
+    tf->frag_active = false;
+    msg->type = tf->frag_type;
+    msg->data = tf->frag_buf;
+    msg->len = tf->frag_len;
+    return true;
+}
+#endif
+
+/** Pass a received message to the listeners */
+static void _TF_FN dispatch_message(TinyFrame *tf)
 {
     TF_COUNT i;
+    TF_COUNT slot;
     struct TF_IdListener_ *ilst;
     struct TF_TypeListener_ *tlst;
     struct TF_GenericListener_ *glst;
@@ -442,17 +1862,34 @@ static void _TF_FN TF_HandleReceivedMessage(TinyFrame *tf)
     msg.type = tf->type;
     msg.data = tf->data;
     msg.len = tf->len;
+#if TF_USE_ZEROCOPY_RX
+    if (tf->data_ext != NULL) {
+        msg.data = tf->data_ext;
+    }
+#endif
+
+#if TF_USE_FRAGMENTS
+    // Fragments are passed on only as the whole message, when the last one arrives
+    if (msg.type == TF_FRAG_TYPE && !frag_accept(tf, &msg)) {
+        return;
+    }
+#endif
 
     // Any listener can consume the message, or let someone else handle it.
 
-    // The loop upper bounds are the highest currently used slot index
-    // (or close to it, depending on the order of listener removals).
+    // ID and type listeners are looked up in their index. Generic listeners are kept
+    // in a dense array in registration order - a listener removed during dispatch only
+    // leaves a hole, which is compacted when the dispatch is over (listeners_tidy).
 
-    // ID listeners first
-    for (i = 0; i < tf->count_id_lst; i++) {
-        ilst = &tf->id_listeners[i];
+    // ID listeners first, found through the index
+    slot = id_index_first(tf, msg.frame_id);
+    while (slot != 0) {
+        i = (TF_COUNT) (slot - 1);
+        ilst = ID_LST(tf, i);
+        slot = ilst->next;
 
-        if (ilst->fn && ilst->id == msg.frame_id) {
+        // listeners removed during the dispatch stay linked until it's over, skip them
+        if (ilst->fn != NULL) {
             msg.userdata = ilst->userdata; // pass userdata pointer to the callback
             msg.userdata2 = ilst->userdata2;
             res = ilst->fn(tf, &msg);
@@ -461,8 +1898,8 @@ static void _TF_FN TF_HandleReceivedMessage(TinyFrame *tf)
 
             if (res != TF_NEXT) {
                 // if it's TF_CLOSE, we assume user already cleaned up userdata
-                if (res == TF_RENEW) {
-                    renew_id_listener(ilst);
+                if (res == TF_RENEW && ilst->fn != NULL) { // unless the callback removed it
+                    renew_id_listener(tf, i);
                 }
                 else if (res == TF_CLOSE) {
                     // Set userdata to NULL to avoid calling user for cleanup
@@ -479,9 +1916,12 @@ static void _TF_FN TF_HandleReceivedMessage(TinyFrame *tf)
     msg.userdata = NULL;
     msg.userdata2 = NULL;
 
-    // Type listeners
-    for (i = 0; i < tf->count_type_lst; i++) {
-        tlst = &tf->type_listeners[i];
+    // Type listeners, found through the index
+    slot = type_index_first(tf, msg.type);
+    while (slot != 0) {
+        i = (TF_COUNT) (slot - 1);
+        tlst = TYPE_LST(tf, i);
+        slot = tlst->next;
 
         if (tlst->fn && tlst->type == msg.type) {
             res = tlst->fn(tf, &msg);
@@ -495,15 +1935,20 @@ static void _TF_FN TF_HandleReceivedMessage(TinyFrame *tf)
                 }
                 return;
             }
+
+            // the listener may have been removed and its slot reused by the callback
+            if (tlst->fn && tlst->type == msg.type) {
+                slot = tlst->next;
+            }
         }
     }
 
     // Generic listeners
     for (i = 0; i < tf->count_generic_lst; i++) {
-        glst = &tf->generic_listeners[i];
+        glst = GENERIC_LST(tf, i);
 
         if (glst->fn) {
-            res = glst->fn(tf, &msg);
+            res = glst->fn(tf, &msg); // the table may be reallocated by the callback, don't use glst after this
 
             if (res != TF_NEXT) {
                 // generic listeners don't have userdata.
@@ -514,7 +1959,7 @@ static void _TF_FN TF_HandleReceivedMessage(TinyFrame *tf)
                 // handled the message.
 
                 if (res == TF_CLOSE) {
-                    cleanup_generic_listener(tf, i, glst);
+                    cleanup_generic_listener(tf, i);
                 }
                 return;
             }
@@ -524,18 +1969,27 @@ static void _TF_FN TF_HandleReceivedMessage(TinyFrame *tf)
     TF_Error("Unhandled message, type %d", (int)msg.type);
 }
 
+/** Handle a message that was just collected & verified by the parser */
+static void _TF_FN TF_HandleReceivedMessage(TinyFrame *tf)
+{
+    listeners_hold(tf);
+    dispatch_message(tf);
+    listeners_unhold(tf);
+}
+
+/** Set or clear the stream listener */
+void _TF_FN TF_SetStreamListener(TinyFrame *tf, TF_StreamListener cb)
+{
+    tf->stream_listener = cb;
+}
+
 /** Externally renew an ID listener */
 bool _TF_FN TF_RenewIdListener(TinyFrame *tf, TF_ID id)
 {
-    TF_COUNT i;
-    struct TF_IdListener_ *lst;
-    for (i = 0; i < tf->count_id_lst; i++) {
-        lst = &tf->id_listeners[i];
-        // test if live & matching
-        if (lst->fn != NULL && lst->id == id) {
-            renew_id_listener(lst);
-            return true;
-        }
+    TF_COUNT slot = id_index_live(tf, id);
+    if (slot != 0) {
+        renew_id_listener(tf, (TF_COUNT) (slot - 1));
+        return true;
     }
 
     TF_Error("Renew listener: not found (id %d)", (int)id);
@@ -547,13 +2001,28 @@ bool _TF_FN TF_RenewIdListener(TinyFrame *tf, TF_ID id)
 
 //region Parser
 
-/** Handle a received byte buffer */
-void _TF_FN TF_Accept(TinyFrame *tf, const uint8_t *buffer, uint32_t count)
+/** Pass an event about the frame being received to the stream listener */
+static TF_Result _TF_FN stream_notify(TinyFrame *tf, TF_StreamEvent event, const uint8_t *data, TF_LEN len)
 {
-    uint32_t i;
-    for (i = 0; i < count; i++) {
-        TF_AcceptChar(tf, buffer[i]);
-    }
+    TF_Msg msg;
+    if (tf->stream_listener == NULL) return TF_NEXT; // removed by the user meanwhile
+
+    TF_ClearMsg(&msg);
+    msg.frame_id = tf->id;
+    msg.type = tf->type;
+    msg.data = data;
+    msg.len = len;
+    return tf->stream_listener(tf, &msg, event);
+}
+
+/** Pass payload bytes collected in the data buffer to the stream listener */
+static void _TF_FN stream_flush(TinyFrame *tf)
+{
+    TF_LEN len = tf->chunk_len;
+    if (len == 0) return;
+
+    tf->chunk_len = 0;
+    stream_notify(tf, TF_STREAM_DATA, tf->data, len);
 }
 
 /** Reset the parser's internal state. */
@@ -561,35 +2030,167 @@ void _TF_FN TF_ResetParser(TinyFrame *tf)
 {
     tf->state = TFState_SOF;
     // more init will be done by the parser when the first byte is received
+
+    // A streamed frame that didn't finish
+    if (tf->streaming) {
+        tf->streaming = false;
+        stream_notify(tf, TF_STREAM_ABORT, NULL, tf->len);
+    }
+}
+
+/** Reset the parser if the partial frame timed out. Called before consuming input. */
+static inline void _TF_FN pars_check_timeout(TinyFrame *tf)
+{
+    // Parser timeout - clear
+    if (tf->parser_timeout_ticks >= TF_PARSER_TIMEOUT_TICKS) {
+        if (tf->state != TFState_SOF) {
+            TF_ResetParser(tf);
+            TF_Error("Parser timeout");
+        }
+    }
+    tf->parser_timeout_ticks = 0;
+}
+
+/** SOF was received - prepare for the frame */
+static void _TF_FN pars_begin_frame(TinyFrame *tf) {
+    // Reset state vars
+    CKSUM_RESET(tf->cksum);
+#if TF_USE_SOF_BYTE
+    CKSUM_ADD(tf->cksum, TF_SOF_BYTE);
+#endif
+
+    tf->discard_data = false;
+    tf->chunk_len = 0;
+#if TF_USE_ZEROCOPY_RX
+    tf->data_ext = NULL;
+#endif
+
+    // Enter ID state
+    tf->state = TFState_ID;
+    tf->rxi = 0;
+}
+
+/** The whole header was collected (and its checksum verified) - enter the payload */
+static void _TF_FN pars_head_done(TinyFrame *tf)
+{
+    if (tf->len == 0) {
+        // if the message has no body, we're done.
+        TF_HandleReceivedMessage(tf);
+        TF_ResetParser(tf);
+        return;
+    }
+
+    // Enter DATA state
+    tf->state = TFState_DATA;
+    tf->rxi = 0;
+
+    CKSUM_RESET(tf->cksum); // Start collecting the payload
+}
+
+/** Size of the checksum field following the payload */
+#if TF_CKSUM_TYPE == TF_CKSUM_NONE
+    #define TF_DATA_CKSUM_LEN 0
+#else
+    #define TF_DATA_CKSUM_LEN sizeof(TF_CKSUM)
+#endif
+
+/**
+ * The first payload byte is about to be consumed - decide where the payload goes
+ *
+ * @param tf - instance
+ * @param buf - payload bytes available in the buffer passed to TF_Accept (can be NULL)
+ * @param avail - nr of bytes available
+ */
+static void _TF_FN pars_data_begin(TinyFrame *tf, const uint8_t *buf, uint32_t avail)
+{
+#if TF_USE_ZEROCOPY_RX
+    // The rest of the frame is all in the caller's buffer, which stays valid until
+    // the message is handled - the payload doesn't have to be copied.
+    if (buf != NULL && avail >= (uint32_t) tf->len + TF_DATA_CKSUM_LEN) {
+        tf->data_ext = buf;
+        return;
+    }
+#else
+    (void)buf;
+    (void)avail;
+#endif
+
+    if (tf->len > TF_MAX_PAYLOAD_RX) {
+        // Too long for the buffer - the stream listener can take it in pieces
+        if (tf->stream_listener != NULL
+            && stream_notify(tf, TF_STREAM_BEGIN, NULL, tf->len) != TF_NEXT) {
+            tf->streaming = true;
+            return;
+        }
+
+        TF_Error("Rx payload too long: %d", (int)tf->len);
+        // ERROR - frame too long. Consume, but do not store.
+        tf->discard_data = true;
+    }
+}
+
+/** A complete frame was received and verified - hand it over to the listeners */
+static void _TF_FN pars_dispatch(TinyFrame *tf)
+{
+    if (tf->streaming) {
+        tf->streaming = false;
+        stream_notify(tf, TF_STREAM_END, NULL, tf->len);
+    } else {
+        TF_HandleReceivedMessage(tf);
+    }
 }
 
-/** SOF was received - prepare for the frame */
-static void _TF_FN pars_begin_frame(TinyFrame *tf) {
-    // Reset state vars
-    CKSUM_RESET(tf->cksum);
-#if TF_USE_SOF_BYTE
-    CKSUM_ADD(tf->cksum, TF_SOF_BYTE);
-#endif
+/** The header checksum was collected - verify it */
+static void _TF_FN pars_head_cksum_done(TinyFrame *tf)
+{
+    // Check the header checksum against the computed value
+    CKSUM_FINALIZE(tf->cksum);
 
-    tf->discard_data = false;
+    if (tf->cksum != tf->ref_cksum) {
+        TF_Error("Rx head cksum mismatch");
+        TF_ResetParser(tf);
+        return;
+    }
 
-    // Enter ID state
-    tf->state = TFState_ID;
+    pars_head_done(tf);
+}
+
+/** All payload bytes were collected */
+static void _TF_FN pars_data_done(TinyFrame *tf)
+{
+#if TF_CKSUM_TYPE == TF_CKSUM_NONE
+    // All done
+    if (!tf->discard_data) {
+        pars_dispatch(tf);
+    }
+    TF_ResetParser(tf);
+#else
+    // Enter DATA_CKSUM state
+    tf->state = TFState_DATA_CKSUM;
     tf->rxi = 0;
+    tf->ref_cksum = 0;
+#endif
 }
 
-/** Handle a received char - here's the main state machine */
-void _TF_FN TF_AcceptChar(TinyFrame *tf, unsigned char c)
+/** The payload checksum was collected - verify it and dispatch the message */
+static void _TF_FN pars_data_cksum_done(TinyFrame *tf)
 {
-    // Parser timeout - clear
-    if (tf->parser_timeout_ticks >= TF_PARSER_TIMEOUT_TICKS) {
-        if (tf->state != TFState_SOF) {
-            TF_ResetParser(tf);
-            TF_Error("Parser timeout");
+    // Check the payload checksum against the computed value
+    CKSUM_FINALIZE(tf->cksum);
+    if (!tf->discard_data) {
+        if (tf->cksum == tf->ref_cksum) {
+            pars_dispatch(tf);
+        } else {
+            TF_Error("Body cksum mismatch");
         }
     }
-    tf->parser_timeout_ticks = 0;
 
+    TF_ResetParser(tf); // a streamed frame that failed the check is aborted here
+}
+
+/** Handle a received char - here's the main state machine */
+static void _TF_FN pars_char(TinyFrame *tf, uint8_t c)
+{
 // DRY snippet - collect multi-byte number from the input stream, byte by byte
 // This is a little dirty, but makes the code easier to read. It's used like e.g. if(),
 // the body is run only after the entire number (of data type 'type') was received
@@ -633,8 +2234,7 @@ void _TF_FN TF_AcceptChar(TinyFrame *tf, unsigned char c)
             CKSUM_ADD(tf->cksum, c);
             COLLECT_NUMBER(tf->type, TF_TYPE) {
                 #if TF_CKSUM_TYPE == TF_CKSUM_NONE
-                    tf->state = TFState_DATA;
-                    tf->rxi = 0;
+                    pars_head_done(tf);
                 #else
                     // enter HEAD_CKSUM state
                     tf->state = TFState_HEAD_CKSUM;
@@ -646,75 +2246,195 @@ void _TF_FN TF_AcceptChar(TinyFrame *tf, unsigned char c)
 
         case TFState_HEAD_CKSUM:
             COLLECT_NUMBER(tf->ref_cksum, TF_CKSUM) {
-                // Check the header checksum against the computed value
-                CKSUM_FINALIZE(tf->cksum);
-
-                if (tf->cksum != tf->ref_cksum) {
-                    TF_Error("Rx head cksum mismatch");
-                    TF_ResetParser(tf);
-                    break;
-                }
-
-                if (tf->len == 0) {
-                    // if the message has no body, we're done.
-                    TF_HandleReceivedMessage(tf);
-                    TF_ResetParser(tf);
-                    break;
-                }
-
-                // Enter DATA state
-                tf->state = TFState_DATA;
-                tf->rxi = 0;
-
-                CKSUM_RESET(tf->cksum); // Start collecting the payload
-
-                if (tf->len > TF_MAX_PAYLOAD_RX) {
-                    TF_Error("Rx payload too long: %d", (int)tf->len);
-                    // ERROR - frame too long. Consume, but do not store.
-                    tf->discard_data = true;
-                }
+                pars_head_cksum_done(tf);
             }
             break;
 
         case TFState_DATA:
+            if (tf->rxi == 0) {
+                pars_data_begin(tf, NULL, 0);
+            }
+
             if (tf->discard_data) {
                 tf->rxi++;
+            } else if (tf->streaming) {
+                CKSUM_ADD(tf->cksum, c);
+                tf->data[tf->chunk_len++] = c;
+                tf->rxi++;
+                // pass on a full buffer or the last piece
+                if (tf->chunk_len == TF_MAX_PAYLOAD_RX || tf->rxi == tf->len) {
+                    stream_flush(tf);
+                }
             } else {
                 CKSUM_ADD(tf->cksum, c);
                 tf->data[tf->rxi++] = c;
             }
 
             if (tf->rxi == tf->len) {
-                #if TF_CKSUM_TYPE == TF_CKSUM_NONE
-                    // All done
-                    TF_HandleReceivedMessage(tf);
-                    TF_ResetParser(tf);
-                #else
-                    // Enter DATA_CKSUM state
-                    tf->state = TFState_DATA_CKSUM;
-                    tf->rxi = 0;
-                    tf->ref_cksum = 0;
-                #endif
+                pars_data_done(tf);
             }
             break;
 
         case TFState_DATA_CKSUM:
             COLLECT_NUMBER(tf->ref_cksum, TF_CKSUM) {
-                // Check the header checksum against the computed value
-                CKSUM_FINALIZE(tf->cksum);
-                if (!tf->discard_data) {
-                    if (tf->cksum == tf->ref_cksum) {
-                        TF_HandleReceivedMessage(tf);
-                    } else {
-                        TF_Error("Body cksum mismatch");
-                    }
-                }
-
-                TF_ResetParser(tf);
+                pars_data_cksum_done(tf);
             }
             break;
     }
     //@formatter:on
+
+#undef COLLECT_NUMBER
+}
+
+/** Handle a received char */
+void _TF_FN TF_AcceptChar(TinyFrame *tf, unsigned char c)
+{
+    pars_check_timeout(tf);
+    pars_char(tf, c);
+}
+
+/** Read a big-endian number of 'size' bytes from the input buffer */
+static inline uint32_t _TF_FN pars_read_num(const uint8_t *buf, uint8_t size)
+{
+    uint32_t num = 0;
+    uint8_t i;
+    for (i = 0; i < size; i++) {
+        num = (num << 8) | buf[i];
+    }
+    return num;
+}
+
+/** Size of the frame header following the SOF byte (ID, LEN, TYPE and its checksum) */
+#if TF_CKSUM_TYPE == TF_CKSUM_NONE
+    #define TF_HEAD_FIELDS_LEN (sizeof(TF_ID) + sizeof(TF_LEN) + sizeof(TF_TYPE))
+#else
+    #define TF_HEAD_FIELDS_LEN (sizeof(TF_ID) + sizeof(TF_LEN) + sizeof(TF_TYPE) + sizeof(TF_CKSUM))
+#endif
+
+/**
+ * Decode a complete header (everything after the SOF byte) in one step.
+ * The parser must be in the ID state with no ID bytes collected yet.
+ *
+ * @param tf - instance
+ * @param buf - buffer holding at least TF_HEAD_FIELDS_LEN bytes
+ */
+static void _TF_FN pars_head(TinyFrame *tf, const uint8_t *buf)
+{
+    const uint8_t *p = buf;
+
+    tf->id = (TF_ID) pars_read_num(p, sizeof(TF_ID));
+    p += sizeof(TF_ID);
+    tf->len = (TF_LEN) pars_read_num(p, sizeof(TF_LEN));
+    p += sizeof(TF_LEN);
+    tf->type = (TF_TYPE) pars_read_num(p, sizeof(TF_TYPE));
+    p += sizeof(TF_TYPE);
+
+    tf->cksum = TF_CksumAddBuf(tf->cksum, buf, (uint32_t) (p - buf));
+
+#if TF_CKSUM_TYPE == TF_CKSUM_NONE
+    pars_head_done(tf);
+#else
+    tf->ref_cksum = (TF_CKSUM) pars_read_num(p, sizeof(TF_CKSUM));
+    pars_head_cksum_done(tf);
+#endif
+}
+
+/**
+ * Consume as many payload bytes as are available, in one step.
+ *
+ * @param tf - instance
+ * @param buf - payload bytes
+ * @param count - nr of bytes available
+ * @return nr of bytes consumed
+ */
+static uint32_t _TF_FN pars_data(TinyFrame *tf, const uint8_t *buf, uint32_t count)
+{
+    uint32_t n;
+    uint32_t pos;
+    uint32_t piece;
+
+    if (tf->rxi == 0) {
+        pars_data_begin(tf, buf, count);
+    }
+
+    n = TF_MIN((uint32_t) (tf->len - tf->rxi), count);
+
+    if (tf->streaming) {
+        tf->cksum = TF_CksumAddBuf(tf->cksum, buf, n);
+        // bytes collected by TF_AcceptChar() go first, the rest is passed without copying,
+        // in pieces no longer than those from TF_AcceptChar()
+        stream_flush(tf);
+        for (pos = 0; pos < n; pos += piece) {
+            piece = TF_MIN(n - pos, TF_MAX_PAYLOAD_RX);
+            stream_notify(tf, TF_STREAM_DATA, buf + pos, (TF_LEN) piece);
+        }
+    }
+    else if (!tf->discard_data) {
+        tf->cksum = TF_CksumAddBuf(tf->cksum, buf, n);
+#if TF_USE_ZEROCOPY_RX
+        if (tf->data_ext == NULL) {
+            memcpy(&tf->data[tf->rxi], buf, n);
+        }
+#else
+        memcpy(&tf->data[tf->rxi], buf, n);
+#endif
+    }
+    tf->rxi = (TF_LEN) (tf->rxi + n);
+
+    if (tf->rxi == tf->len) {
+        pars_data_done(tf);
+    }
+    return n;
+}
+
+#if TF_USE_SOF_BYTE
+/**
+ * Skip garbage up to the next SOF byte candidate.
+ * memchr() is vectorized by any decent C library, which makes resynchronization
+ * after a burst of line noise much cheaper than feeding it through the state machine.
+ *
+ * @param buf - bytes to scan
+ * @param count - nr of bytes in the buffer
+ * @return nr of bytes to skip (count if there's no SOF byte in the buffer)
+ */
+static inline uint32_t _TF_FN pars_find_sof(const uint8_t *buf, uint32_t count)
+{
+    const uint8_t *sof = memchr(buf, TF_SOF_BYTE, count);
+    return sof ? (uint32_t) (sof - buf) : count;
+}
+#endif
+
+/** Handle a received byte buffer */
+void _TF_FN TF_Accept(TinyFrame *tf, const uint8_t *buffer, uint32_t count)
+{
+    uint32_t i = 0;
+
+    if (count == 0) return;
+
+    // The tick counter can't advance while we're in here, so one check is enough
+    pars_check_timeout(tf);
+
+    while (i < count) {
+#if TF_USE_SOF_BYTE
+        // Resync - jump straight to the next possible start of a frame
+        if (tf->state == TFState_SOF) {
+            i += pars_find_sof(buffer + i, count - i);
+            if (i == count) break;
+        }
+#endif
+
+        // Fast paths - consume whole fields at once if they're all in the buffer
+        if (tf->state == TFState_DATA) {
+            i += pars_data(tf, buffer + i, count - i);
+        }
+        else if (tf->state == TFState_ID && tf->rxi == 0 && count - i >= TF_HEAD_FIELDS_LEN) {
+            pars_head(tf, buffer + i);
+            i += TF_HEAD_FIELDS_LEN;
+        }
+        else {
+            pars_char(tf, buffer[i++]);
+        }
+    }
 }
 
 //endregion Parser
@@ -761,6 +2481,42 @@ void _TF_FN TF_AcceptChar(TinyFrame *tf, unsigned char c)
  */
 #define WRITENUM_CKSUM(type, num) WRITENUM_BASE(type, num, CKSUM_ADD(cksum, b))
 
+/**
+ * Compose the header of a frame from a template (see TF_InitTemplate), with a new ID.
+ *
+ * @param outbuff - buffer to store the result in
+ * @param tpl - template
+ * @return nr of bytes in outbuff used by the header
+ */
+static inline uint32_t _TF_FN TF_ComposeTemplateHead(TinyFrame *tf, uint8_t *outbuff, const TF_FrameTemplate *tpl)
+{
+    int8_t si = 0; // signed small int
+    uint8_t b = 0;
+    TF_ID id = 0;
+    TF_CKSUM cksum = tpl->head_cksum;
+    uint32_t pos = TF_SOF_BYTES;
+
+    (void)cksum; // suppress "unused" warning if checksums are disabled
+
+    id = (TF_ID) (TF_TAKE_ID(tf) & TF_ID_MASK);
+    if (tf->peer_bit) {
+        id |= TF_ID_PEERBIT;
+    }
+
+    memcpy(outbuff, tpl->head, sizeof(tpl->head));
+    WRITENUM_CKSUM(TF_ID, id);
+
+#if TF_CKSUM_TYPE != TF_CKSUM_NONE
+    // Length and type are already in place, only add them to the checksum
+    cksum = TF_CksumAddBuf(cksum, outbuff + pos, TF_LEN_BYTES + TF_TYPE_BYTES);
+    pos += TF_LEN_BYTES + TF_TYPE_BYTES;
+    CKSUM_FINALIZE(cksum);
+    WRITENUM(TF_CKSUM, cksum);
+#endif
+
+    return (uint32_t) sizeof(tpl->head);
+}
+
 /**
  * Compose a frame (used internally by TF_Send and TF_Respond).
  * The frame can be sent using TF_WriteImpl(), or received by TF_Accept()
@@ -786,7 +2542,7 @@ static inline uint32_t _TF_FN TF_ComposeHead(TinyFrame *tf, uint8_t *outbuff, TF
         id = msg->frame_id;
     }
     else {
-        id = (TF_ID) (tf->next_id++ & TF_ID_MASK);
+        id = (TF_ID) (TF_TAKE_ID(tf) & TF_ID_MASK);
         if (tf->peer_bit) {
             id |= TF_ID_PEERBIT;
         }
@@ -815,49 +2571,227 @@ static inline uint32_t _TF_FN TF_ComposeHead(TinyFrame *tf, uint8_t *outbuff, TF
 }
 
 /**
- * Compose a frame (used internally by TF_Send and TF_Respond).
- * The frame can be sent using TF_WriteImpl(), or received by TF_Accept()
+ * Finalize a frame
  *
  * @param outbuff - buffer to store the result in
- * @param data - data buffer
- * @param data_len - data buffer len
- * @param cksum - checksum variable, used for all calls to TF_ComposeBody. Must be reset before first use! (CKSUM_RESET(cksum);)
+ * @param cksum - checksum variable used for the body
  * @return nr of bytes in outbuff used
  */
-static inline uint32_t _TF_FN TF_ComposeBody(uint8_t *outbuff,
-                                    const uint8_t *data, TF_LEN data_len,
-                                    TF_CKSUM *cksum)
+static inline uint32_t _TF_FN TF_ComposeTail(uint8_t *outbuff, TF_CKSUM *cksum)
 {
-    TF_LEN i = 0;
+    int8_t si = 0; // signed small int
     uint8_t b = 0;
     uint32_t pos = 0;
 
-    for (i = 0; i < data_len; i++) {
-        b = data[i];
-        outbuff[pos++] = b;
-        CKSUM_ADD(*cksum, b);
+#if TF_CKSUM_TYPE != TF_CKSUM_NONE
+    CKSUM_FINALIZE(*cksum);
+    WRITENUM(TF_CKSUM, *cksum);
+#endif
+    return pos;
+}
+
+#if TF_TX_COALESCE
+static void _TF_FN txq_flush(TinyFrame *tf);
+#endif
+
+#if TF_TX_NONBLOCK
+/** Write out as much of the outbound ring as the transport accepts. The Tx interface must be claimed. */
+static void _TF_FN txr_drain(TinyFrame *tf)
+{
+    uint32_t chunk;
+    uint32_t n;
+
+    while (tf->txr_len > 0) {
+        chunk = TF_MIN(tf->txr_len, TF_TX_NONBLOCK - tf->txr_pos);
+        n = TF_TryWriteImpl(tf, (const uint8_t *) (tf->txr + tf->txr_pos), chunk);
+        tf->txr_pos = (tf->txr_pos + n) % TF_TX_NONBLOCK;
+        tf->txr_len -= n;
+        if (n < chunk) break;
     }
+}
 
-    return pos;
+/**
+ * Check there's room in the outbound ring for a frame. Bytes waiting in the coalescing
+ * buffer must fit in it as well - if they're in the way, they're moved to the ring.
+ *
+ * @param tf - instance
+ * @param length - frame length
+ * @return TF_TX_OK if it fits
+ */
+static TF_TxResult _TF_FN txr_reserve(TinyFrame *tf, uint32_t length)
+{
+#if TF_TX_COALESCE
+    uint32_t queued = tf->txq_len;
+#else
+    uint32_t queued = 0;
+#endif
+
+    if (length > TF_TX_NONBLOCK) {
+        TF_Error("Frame too long for the outbound buffer (%d)", (int) length);
+        return TF_TX_FAIL;
+    }
+
+    if (TF_TX_NONBLOCK - tf->txr_len - queued >= length) return TF_TX_OK;
+
+    // Maybe the transport can take some now
+    txr_drain(tf);
+    if (TF_TX_NONBLOCK - tf->txr_len - queued >= length) return TF_TX_OK;
+
+#if TF_TX_COALESCE
+    if (queued > 0) {
+        txq_flush(tf);
+        if (TF_TX_NONBLOCK - tf->txr_len >= length) return TF_TX_OK;
+    }
+#endif
+
+    return TF_TX_WOULDBLOCK;
 }
+#endif
 
+#if !TF_USE_WRITEV
 /**
- * Finalize a frame
+ * Write bytes to the transport
  *
- * @param outbuff - buffer to store the result in
- * @param cksum - checksum variable used for the body
- * @return nr of bytes in outbuff used
+ * @param tf - instance
+ * @param buff - bytes to write
+ * @param length - count
  */
-static inline uint32_t _TF_FN TF_ComposeTail(uint8_t *outbuff, TF_CKSUM *cksum)
+static void _TF_FN tx_out(TinyFrame *tf, const uint8_t *buff, uint32_t length)
 {
-    int8_t si = 0; // signed small int
-    uint8_t b = 0;
-    uint32_t pos = 0;
+#if TF_TX_NONBLOCK
+    uint32_t end;
+    uint32_t chunk;
 
-#if TF_CKSUM_TYPE != TF_CKSUM_NONE
-    CKSUM_FINALIZE(*cksum);
-    WRITENUM(TF_CKSUM, *cksum);
+    // Nothing may overtake bytes that are already waiting
+    if (tf->txr_len == 0 && length > 0) {
+        chunk = TF_TryWriteImpl(tf, buff, length);
+        buff += chunk;
+        length -= chunk;
+    }
+
+    // Store the rest, there's room for it (txr_reserve)
+    while (length > 0) {
+        end = (tf->txr_pos + tf->txr_len) % TF_TX_NONBLOCK;
+        chunk = TF_MIN(length, TF_TX_NONBLOCK - end);
+        memcpy(tf->txr + end, buff, chunk);
+        tf->txr_len += chunk;
+        buff += chunk;
+        length -= chunk;
+    }
+#else
+    TF_WriteImpl(tf, buff, length);
+#endif
+}
+#endif
+
+#if TF_TX_COALESCE
+/** Write out the coalescing buffer. The Tx interface must be claimed. */
+static void _TF_FN txq_flush(TinyFrame *tf)
+{
+#if TF_USE_WRITEV
+    TF_IoVec iov;
+#endif
+
+    if (tf->txq_len == 0) return;
+
+#if TF_USE_WRITEV
+    iov.data = tf->txq;
+    iov.len = tf->txq_len;
+    TF_WriteVImpl(tf, &iov, 1);
+#else
+    tx_out(tf, (const uint8_t *) tf->txq, tf->txq_len);
+#endif
+    tf->txq_len = 0;
+}
+#endif
+
+/**
+ * Write pieces of a frame. With TF_TX_COALESCE, they're collected in the coalescing
+ * buffer if they fit in it.
+ *
+ * @param tf - instance
+ * @param iov - pieces to write, must not be empty with TF_USE_WRITEV
+ * @param iovcnt - number of pieces
+ */
+static void _TF_FN tx_writev(TinyFrame *tf, const TF_IoVec *iov, uint8_t iovcnt)
+{
+    uint8_t i;
+#if TF_TX_COALESCE
+    uint32_t total = 0;
+
+    for (i = 0; i < iovcnt; i++) {
+        total += iov[i].len;
+    }
+    if (total == 0) return;
+
+    if (total > TF_TX_COALESCE - tf->txq_len) {
+        txq_flush(tf);
+    }
+
+    if (total <= TF_TX_COALESCE) {
+        if (tf->txq_len == 0) {
+            tf->txq_age = 0;
+        }
+        for (i = 0; i < iovcnt; i++) {
+            if (iov[i].len == 0) continue;
+            memcpy(tf->txq + tf->txq_len, iov[i].data, iov[i].len);
+            tf->txq_len += iov[i].len;
+        }
+        if (tf->txq_len == TF_TX_COALESCE) {
+            txq_flush(tf);
+        }
+        return;
+    }
+#endif
+
+#if TF_USE_WRITEV
+    (void) i;
+    TF_WriteVImpl(tf, iov, iovcnt);
+#else
+    for (i = 0; i < iovcnt; i++) {
+        tx_out(tf, iov[i].data, iov[i].len);
+    }
+#endif
+}
+
+/**
+ * Write bytes from the Tx buffer
+ *
+ * @param tf - instance
+ * @param buff - bytes to write
+ * @param length - count
+ */
+static inline void _TF_FN tx_write(TinyFrame *tf, const uint8_t *buff, uint32_t length)
+{
+    TF_IoVec iov;
+#if TF_USE_WRITEV
+    if (length == 0) return;
 #endif
+    iov.data = buff;
+    iov.len = length;
+    tx_writev(tf, &iov, 1);
+}
+
+/** compose a whole frame into a buffer given by the caller */
+uint32_t _TF_FN TF_ComposeFrame(TinyFrame *tf, TF_Msg *msg, uint8_t *outbuff, uint32_t capacity)
+{
+    uint32_t pos;
+    TF_CKSUM cksum;
+
+    if (capacity < TF_FRAME_LEN(msg->len) || (msg->len > 0 && msg->data == NULL)) {
+        return 0;
+    }
+
+    pos = TF_ComposeHead(tf, outbuff, msg);
+
+    // Checksum only if message had a body
+    if (msg->len > 0) {
+        memcpy(outbuff + pos, msg->data, msg->len);
+        CKSUM_RESET(cksum);
+        cksum = TF_CksumAddBuf(cksum, outbuff + pos, msg->len);
+        pos += msg->len;
+        pos += TF_ComposeTail(outbuff + pos, &cksum);
+    }
     return pos;
 }
 
@@ -869,11 +2803,23 @@ static inline uint32_t _TF_FN TF_ComposeTail(uint8_t *outbuff, TF_CKSUM *cksum)
  * @param listener - response listener or NULL
  * @param ftimeout - time out callback
  * @param timeout - listener timeout ticks, 0 = indefinite
- * @return success (mutex claimed and listener added, if any)
+ * @return TF_TX_OK if the mutex was claimed and listener added, if any
  */
-static bool _TF_FN TF_SendFrame_Begin(TinyFrame *tf, TF_Msg *msg, TF_Listener listener, TF_Listener_Timeout ftimeout, TF_TICKS timeout)
+static TF_TxResult _TF_FN TF_SendFrame_Begin(TinyFrame *tf, TF_Msg *msg, TF_Listener listener, TF_Listener_Timeout ftimeout, TF_TICKS timeout)
 {
-    TF_TRY(TF_ClaimTx(tf));
+#if TF_TX_NONBLOCK
+    TF_TxResult res;
+#endif
+
+    if (!TF_ClaimTx(tf)) return TF_TX_FAIL;
+
+#if TF_TX_NONBLOCK
+    res = txr_reserve(tf, TF_FRAME_LEN(msg->len));
+    if (res != TF_TX_OK) {
+        TF_ReleaseTx(tf);
+        return res;
+    }
+#endif
 
     tf->tx_pos = (uint32_t) TF_ComposeHead(tf, tf->sendbuf, msg); // frame ID is incremented here if it's not a response
     tf->tx_len = msg->len;
@@ -881,66 +2827,143 @@ static bool _TF_FN TF_SendFrame_Begin(TinyFrame *tf, TF_Msg *msg, TF_Listener li
     if (listener) {
         if(!TF_AddIdListener(tf, msg, listener, ftimeout, timeout)) {
             TF_ReleaseTx(tf);
-            return false;
+            return TF_TX_FAIL;
         }
     }
 
     CKSUM_RESET(tf->tx_cksum);
-    return true;
+    return TF_TX_OK;
 }
 
 /**
- * Build and send a part (or all) of a frame body.
- * Caution: this does not check the total length against the length specified in the frame head
+ * Send a part of a frame body, without adding it to the checksum.
  *
  * @param tf - instance
  * @param buff - bytes to write
  * @param length - count
  */
-static void _TF_FN TF_SendFrame_Chunk(TinyFrame *tf, const uint8_t *buff, uint32_t length)
+static void _TF_FN TF_SendFrame_Copy(TinyFrame *tf, const uint8_t *buff, uint32_t length)
 {
     uint32_t remain;
     uint32_t chunk;
     uint32_t sent = 0;
+#if TF_USE_WRITEV
+    TF_IoVec iov[2];
+
+    // A piece that doesn't fit in the Tx buffer is sent as it is, right after the buffered bytes
+    if (length > TF_SENDBUF_LEN - tf->tx_pos) {
+        iov[0].data = tf->sendbuf;
+        iov[0].len = tf->tx_pos;
+        iov[1].data = buff;
+        iov[1].len = length;
+        if (tf->tx_pos > 0) {
+            tx_writev(tf, iov, 2);
+        } else {
+            tx_writev(tf, &iov[1], 1);
+        }
+        tf->tx_pos = 0;
+        return;
+    }
+#endif
 
     remain = length;
     while (remain > 0) {
         // Write what can fit in the tx buffer
         chunk = TF_MIN(TF_SENDBUF_LEN - tf->tx_pos, remain);
-        tf->tx_pos += TF_ComposeBody(tf->sendbuf+tf->tx_pos, buff+sent, (TF_LEN) chunk, &tf->tx_cksum);
+        memcpy(tf->sendbuf + tf->tx_pos, buff + sent, chunk);
+        tf->tx_pos += chunk;
         remain -= chunk;
         sent += chunk;
 
         // Flush if the buffer is full
         if (tf->tx_pos == TF_SENDBUF_LEN) {
-            TF_WriteImpl(tf, (const uint8_t *) tf->sendbuf, tf->tx_pos);
+            tx_write(tf, (const uint8_t *) tf->sendbuf, tf->tx_pos);
             tf->tx_pos = 0;
         }
     }
 }
 
 /**
- * End a multi-part frame. This sends the checksum and releases mutex.
+ * Build and send a part (or all) of a frame body.
+ * Caution: this does not check the total length against the length specified in the frame head
  *
  * @param tf - instance
+ * @param buff - bytes to write
+ * @param length - count
  */
-static void _TF_FN TF_SendFrame_End(TinyFrame *tf)
+static void _TF_FN TF_SendFrame_Chunk(TinyFrame *tf, const uint8_t *buff, uint32_t length)
+{
+    // The whole chunk is checksummed at once, not in pieces the size of the Tx buffer
+    tf->tx_cksum = TF_CksumAddBuf(tf->tx_cksum, buff, length);
+    TF_SendFrame_Copy(tf, buff, length);
+}
+
+/**
+ * Add the payload checksum to the Tx buffer, if the frame has a payload
+ *
+ * @param tf - instance
+ */
+static void _TF_FN TF_SendFrame_Tail(TinyFrame *tf)
 {
     // Checksum only if message had a body
     if (tf->tx_len > 0) {
         // Flush if checksum wouldn't fit in the buffer
         if (TF_SENDBUF_LEN - tf->tx_pos < sizeof(TF_CKSUM)) {
-            TF_WriteImpl(tf, (const uint8_t *) tf->sendbuf, tf->tx_pos);
+            tx_write(tf, (const uint8_t *) tf->sendbuf, tf->tx_pos);
             tf->tx_pos = 0;
         }
 
-        // Add checksum, flush what remains to be sent
         tf->tx_pos += TF_ComposeTail(tf->sendbuf + tf->tx_pos, &tf->tx_cksum);
     }
+}
+
+/**
+ * End a multi-part frame. This sends the checksum and releases mutex.
+ *
+ * @param tf - instance
+ */
+static void _TF_FN TF_SendFrame_End(TinyFrame *tf)
+{
+    TF_SendFrame_Tail(tf);
+
+    // Flush what remains to be sent
+    tx_write(tf, (const uint8_t *) tf->sendbuf, tf->tx_pos);
+    TF_ReleaseTx(tf);
+}
+
+#if TF_USE_WRITEV
+/**
+ * Send the payload and checksum of a frame begun by TF_SendFrame_Begin(),
+ * together with the header, in a single write. The payload is not copied.
+ * The payload must already be added to tf->tx_cksum. This releases the mutex.
+ *
+ * @param tf - instance
+ * @param buff - the whole payload
+ * @param length - payload length
+ */
+static void _TF_FN TF_SendFrame_Whole(TinyFrame *tf, const uint8_t *buff, uint32_t length)
+{
+    TF_IoVec iov[3];
+    uint8_t tail[sizeof(TF_CKSUM)];
+    uint8_t n = 0;
+
+    iov[n].data = tf->sendbuf;
+    iov[n++].len = tf->tx_pos;
+
+    // Checksum only if message had a body
+    if (length > 0) {
+        iov[n].data = buff;
+        iov[n++].len = length;
+
+        iov[n].data = tail;
+        iov[n].len = TF_ComposeTail(tail, &tf->tx_cksum);
+        if (iov[n].len > 0) n++;
+    }
 
-    TF_WriteImpl(tf, (const uint8_t *) tf->sendbuf, tf->tx_pos);
+    tx_writev(tf, iov, n);
     TF_ReleaseTx(tf);
 }
+#endif
 
 /**
  * Send a message
@@ -950,19 +2973,90 @@ static void _TF_FN TF_SendFrame_End(TinyFrame *tf)
  * @param listener - ID listener, or NULL
  * @param ftimeout - time out callback
  * @param timeout - listener timeout, 0 is none
- * @return true if sent
+ * @return TF_TX_OK if sent
  */
-static bool _TF_FN TF_SendFrame(TinyFrame *tf, TF_Msg *msg, TF_Listener listener, TF_Listener_Timeout ftimeout, TF_TICKS timeout)
+static TF_TxResult _TF_FN TF_SendFrame(TinyFrame *tf, TF_Msg *msg, TF_Listener listener, TF_Listener_Timeout ftimeout, TF_TICKS timeout)
 {
-    TF_TRY(TF_SendFrame_Begin(tf, msg, listener, ftimeout, timeout));
+    TF_TxResult res = TF_SendFrame_Begin(tf, msg, listener, ftimeout, timeout);
+    if (res != TF_TX_OK) return res;
+
     if (msg->len == 0 || msg->data != NULL) {
         // Send the payload and checksum only if we're not starting a multi-part frame.
         // A multi-part frame is identified by passing NULL to the data field and setting the length.
         // User then needs to call those functions manually
+#if TF_USE_WRITEV
+        tf->tx_cksum = TF_CksumAddBuf(tf->tx_cksum, msg->data, msg->len);
+        TF_SendFrame_Whole(tf, msg->data, msg->len);
+#else
         TF_SendFrame_Chunk(tf, msg->data, msg->len);
         TF_SendFrame_End(tf);
+#endif
     }
-    return true;
+    return TF_TX_OK;
+}
+
+/**
+ * Send frames back-to-back, claiming the Tx interface once. They're collected
+ * in the Tx buffer, which is written only when full and at the end.
+ *
+ * @param tf - instance
+ * @param msgs - messages to send, the frame IDs are stored in them
+ * @param count - number of messages
+ * @param listener - ID listener added for each frame, or NULL
+ * @param ftimeout - time out callback
+ * @param timeout - listener timeout, 0 is none
+ * @return number of frames sent - the first ones of msgs
+ */
+static uint32_t _TF_FN TF_SendFrames(TinyFrame *tf, TF_Msg *msgs, uint32_t count, TF_Listener listener, TF_Listener_Timeout ftimeout, TF_TICKS timeout)
+{
+    uint32_t i;
+    uint32_t pos;
+
+    if (!TF_ClaimTx(tf)) return 0;
+    tf->tx_pos = 0;
+
+    for (i = 0; i < count; i++) {
+        if (msgs[i].len > 0 && msgs[i].data == NULL) {
+            TF_Error("Multi-part frame can't be sent in a batch");
+            break;
+        }
+
+#if TF_TX_NONBLOCK
+        // The frames collected so far need room in the outbound buffer as well
+        if (tf->tx_pos + TF_FRAME_LEN(msgs[i].len) > TF_TX_NONBLOCK) {
+            tx_write(tf, (const uint8_t *) tf->sendbuf, tf->tx_pos);
+            tf->tx_pos = 0;
+        }
+        if (txr_reserve(tf, tf->tx_pos + TF_FRAME_LEN(msgs[i].len)) != TF_TX_OK) break;
+#endif
+
+        // Flush if the header wouldn't fit in the buffer
+        if (TF_SENDBUF_LEN - tf->tx_pos < TF_FRAME_LEN(0)) {
+            tx_write(tf, (const uint8_t *) tf->sendbuf, tf->tx_pos);
+            tf->tx_pos = 0;
+        }
+
+        pos = tf->tx_pos;
+        tf->tx_pos += TF_ComposeHead(tf, tf->sendbuf + tf->tx_pos, &msgs[i]);
+        tf->tx_len = msgs[i].len;
+
+        if (listener) {
+            if (!TF_AddIdListener(tf, &msgs[i], listener, ftimeout, timeout)) {
+                tf->tx_pos = pos; // drop the header
+                break;
+            }
+        }
+
+        CKSUM_RESET(tf->tx_cksum);
+        TF_SendFrame_Chunk(tf, msgs[i].data, msgs[i].len);
+        TF_SendFrame_Tail(tf);
+    }
+
+    if (tf->tx_pos > 0) {
+        tx_write(tf, (const uint8_t *) tf->sendbuf, tf->tx_pos);
+    }
+    TF_ReleaseTx(tf);
+    return i;
 }
 
 //endregion Compose and send
@@ -973,7 +3067,7 @@ static bool _TF_FN TF_SendFrame(TinyFrame *tf, TF_Msg *msg, TF_Listener listener
 /** send without listener */
 bool _TF_FN TF_Send(TinyFrame *tf, TF_Msg *msg)
 {
-    return TF_SendFrame(tf, msg, NULL, NULL, 0);
+    return TF_SendFrame(tf, msg, NULL, NULL, 0) == TF_TX_OK;
 }
 
 /** send without listener and struct */
@@ -995,13 +3089,13 @@ bool _TF_FN TF_QuerySimple(TinyFrame *tf, TF_TYPE type, const uint8_t *data, TF_
     msg.type = type;
     msg.data = data;
     msg.len = len;
-    return TF_SendFrame(tf, &msg, listener, ftimeout, timeout);
+    return TF_SendFrame(tf, &msg, listener, ftimeout, timeout) == TF_TX_OK;
 }
 
 /** send with a listener waiting for a reply */
 bool _TF_FN TF_Query(TinyFrame *tf, TF_Msg *msg, TF_Listener listener, TF_Listener_Timeout ftimeout, TF_TICKS timeout)
 {
-    return TF_SendFrame(tf, msg, listener, ftimeout, timeout);
+    return TF_SendFrame(tf, msg, listener, ftimeout, timeout) == TF_TX_OK;
 }
 
 /** Like TF_Send, but with explicit frame ID (set inside the msg object), use for responses */
@@ -1011,6 +3105,180 @@ bool _TF_FN TF_Respond(TinyFrame *tf, TF_Msg *msg)
     return TF_Send(tf, msg);
 }
 
+/** send a frame composed in the caller's buffer, claiming Tx only to write it */
+bool _TF_FN TF_Send_Buffered(TinyFrame *tf, TF_Msg *msg, uint8_t *buf, uint32_t cap)
+{
+    uint32_t len;
+
+    // TF_ComposeFrame() returns 0 for both, tell them apart for the error message
+    if (msg->len > 0 && msg->data == NULL) {
+        TF_Error("TF_Send_Buffered() needs the payload in msg->data");
+        return false;
+    }
+
+    len = TF_ComposeFrame(tf, msg, buf, cap);
+    if (len == 0) {
+        TF_Error("Frame doesn't fit in the buffer (%d < %d)", (int) cap, (int) TF_FRAME_LEN(msg->len));
+        return false;
+    }
+
+    TF_TRY(TF_ClaimTx(tf));
+#if TF_TX_NONBLOCK
+    if (txr_reserve(tf, len) != TF_TX_OK) {
+        TF_ReleaseTx(tf);
+        return false;
+    }
+#endif
+    tx_write(tf, buf, len);
+    TF_ReleaseTx(tf);
+    return true;
+}
+
+/** send several frames under one Tx claim */
+uint32_t _TF_FN TF_SendBatch(TinyFrame *tf, TF_Msg *msgs, uint32_t count)
+{
+    return TF_SendFrames(tf, msgs, count, NULL, NULL, 0);
+}
+
+/** send several frames under one Tx claim, with an ID listener for each */
+uint32_t _TF_FN TF_QueryBatch(TinyFrame *tf, TF_Msg *msgs, uint32_t count, TF_Listener listener, TF_Listener_Timeout ftimeout, TF_TICKS timeout)
+{
+    return TF_SendFrames(tf, msgs, count, listener, ftimeout, timeout);
+}
+
+/** compose the header and let the caller write the payload into the Tx buffer */
+uint8_t * _TF_FN TF_ReserveFrame(TinyFrame *tf, TF_TYPE type, TF_LEN len)
+{
+    TF_Msg msg;
+
+    if (TF_FRAME_LEN(len) > TF_SENDBUF_LEN) {
+        TF_Error("Frame doesn't fit in the Tx buffer (%d)", (int) len);
+        return NULL;
+    }
+
+    TF_ClearMsg(&msg);
+    msg.type = type;
+    msg.len = len;
+    if (TF_SendFrame_Begin(tf, &msg, NULL, NULL, 0) != TF_TX_OK) return NULL;
+
+    return tf->sendbuf + tf->tx_pos;
+}
+
+/** checksum the payload written after TF_ReserveFrame() and send the frame */
+void _TF_FN TF_CommitFrame(TinyFrame *tf)
+{
+    tf->tx_cksum = TF_CksumAddBuf(tf->tx_cksum, tf->sendbuf + tf->tx_pos, tf->tx_len);
+    tf->tx_pos += tf->tx_len;
+    TF_SendFrame_End(tf);
+}
+
+/** compose the parts of a template header that don't change */
+void _TF_FN TF_InitTemplate(TF_FrameTemplate *tpl, TF_TYPE type, TF_LEN len, const uint8_t *data)
+{
+    int8_t si = 0; // signed small int
+    uint8_t b = 0;
+    TF_CKSUM cksum = 0;
+    uint8_t *outbuff = tpl->head;
+    uint32_t pos = 0;
+
+    // The template may be prepared before any instance is initialized
+    cksum_init_tables();
+
+    CKSUM_RESET(cksum);
+#if TF_USE_SOF_BYTE
+    outbuff[pos++] = TF_SOF_BYTE;
+    CKSUM_ADD(cksum, TF_SOF_BYTE);
+#endif
+    tpl->head_cksum = cksum;
+
+    WRITENUM(TF_ID, 0); // filled in when sending
+    WRITENUM(TF_LEN, len);
+    WRITENUM(TF_TYPE, type);
+
+    tpl->len = len;
+    tpl->data = data;
+    CKSUM_RESET(tpl->data_cksum);
+    if (data != NULL) {
+        tpl->data_cksum = TF_CksumAddBuf(tpl->data_cksum, data, len);
+    }
+}
+
+/** send a frame using a template, only the ID and checksums are computed */
+bool _TF_FN TF_SendTemplate(TinyFrame *tf, const TF_FrameTemplate *tpl, const uint8_t *data)
+{
+    if (tpl->len > 0 && data == NULL && tpl->data == NULL) {
+        TF_Error("No payload for the template");
+        return false;
+    }
+
+    TF_TRY(TF_ClaimTx(tf));
+#if TF_TX_NONBLOCK
+    if (txr_reserve(tf, TF_FRAME_LEN(tpl->len)) != TF_TX_OK) {
+        TF_ReleaseTx(tf);
+        return false;
+    }
+#endif
+
+    tf->tx_pos = TF_ComposeTemplateHead(tf, tf->sendbuf, tpl);
+    tf->tx_len = tpl->len;
+
+    if (data == NULL) {
+        // The constant payload was checksummed beforehand
+        data = tpl->data;
+        tf->tx_cksum = tpl->data_cksum;
+    } else {
+        CKSUM_RESET(tf->tx_cksum);
+        tf->tx_cksum = TF_CksumAddBuf(tf->tx_cksum, data, tpl->len);
+    }
+
+#if TF_USE_WRITEV
+    TF_SendFrame_Whole(tf, data, tpl->len);
+#else
+    TF_SendFrame_Copy(tf, data, tpl->len);
+    TF_SendFrame_End(tf);
+#endif
+    return true;
+}
+
+/** send with an optional listener, telling if the outbound buffer was full */
+TF_TxResult _TF_FN TF_TrySend(TinyFrame *tf, TF_Msg *msg, TF_Listener listener, TF_Listener_Timeout ftimeout, TF_TICKS timeout)
+{
+    return TF_SendFrame(tf, msg, listener, ftimeout, timeout);
+}
+
+/** write out what waits in the outbound buffer */
+uint32_t _TF_FN TF_OnWritable(TinyFrame *tf)
+{
+#if TF_TX_NONBLOCK
+    uint32_t pending;
+
+    if (!tx_try_claim(tf)) return 0; // a frame is being sent, see the header
+    txr_drain(tf);
+    pending = tf->txr_len;
+    TF_ReleaseTx(tf);
+    return pending;
+#else
+    (void) tf;
+    return 0;
+#endif
+}
+
+/** bytes waiting in the outbound buffer */
+uint32_t _TF_FN TF_TxPending(TinyFrame *tf)
+{
+#if TF_TX_NONBLOCK
+    uint32_t pending;
+
+    if (!tx_try_claim(tf)) return 0; // a frame is being sent, see the header
+    pending = tf->txr_len;
+    TF_ReleaseTx(tf);
+    return pending;
+#else
+    (void) tf;
+    return 0;
+#endif
+}
+
 //endregion Sending API funcs
 
 
@@ -1049,37 +3317,217 @@ void _TF_FN TF_Multipart_Payload(TinyFrame *tf, const uint8_t *buff, uint32_t le
     TF_SendFrame_Chunk(tf, buff, length);
 }
 
+#if TF_CKSUM_COMBINE
+void _TF_FN TF_Multipart_PayloadCksum(TinyFrame *tf, const uint8_t *buff, uint32_t length, TF_CKSUM cksum)
+{
+    tf->tx_cksum = TF_CksumCombine(tf->tx_cksum, cksum, length);
+    TF_SendFrame_Copy(tf, buff, length);
+}
+#endif
+
 void _TF_FN TF_Multipart_Close(TinyFrame *tf)
 {
     TF_SendFrame_End(tf);
 }
 
+#if TF_USE_FRAGMENTS
+bool _TF_FN TF_SendFragment(TinyFrame *tf, TF_Msg *msg, TF_LEN *offset)
+{
+    int8_t si = 0; // signed small int
+    uint8_t b = 0;
+    uint8_t head[TF_FRAG_HEAD_BYTES];
+    uint8_t *outbuff = head;
+    uint32_t pos = 0;
+    TF_LEN chunk = (TF_LEN) TF_MIN(TF_FRAG_LEN, msg->len - *offset);
+    TF_Msg frag;
+
+    if (msg->len > 0 && msg->data == NULL) {
+        TF_Error("Fragmented message needs the whole payload");
+        return false;
+    }
+
+    TF_ClearMsg(&frag);
+    frag.type = TF_FRAG_TYPE;
+    frag.len = (TF_LEN) (TF_FRAG_HEAD_BYTES + chunk);
+    frag.frame_id = msg->frame_id;
+    // The first fragment takes a new ID (unless it's a response), the others reuse it
+    frag.is_response = (*offset > 0) || msg->is_response;
+
+    WRITENUM(TF_TYPE, msg->type);
+    WRITENUM(TF_LEN, msg->len);
+    WRITENUM(TF_LEN, *offset);
+
+    if (TF_SendFrame_Begin(tf, &frag, NULL, NULL, 0) != TF_TX_OK) return false;
+    msg->frame_id = frag.frame_id;
+
+    TF_SendFrame_Chunk(tf, head, TF_FRAG_HEAD_BYTES);
+    if (chunk > 0) {
+        TF_SendFrame_Chunk(tf, msg->data + *offset, chunk);
+    }
+    TF_SendFrame_End(tf);
+
+    *offset += chunk;
+    return true;
+}
+
+bool _TF_FN TF_SendFragmented(TinyFrame *tf, TF_Msg *msg)
+{
+    TF_LEN offset = 0;
+
+    do {
+        TF_TRY(TF_SendFragment(tf, msg, &offset));
+    } while (offset < msg->len);
+
+    return true;
+}
+#endif
+
+bool _TF_FN TF_Flush(TinyFrame *tf)
+{
+#if TF_TX_COALESCE
+    TF_TRY(TF_ClaimTx(tf));
+    txq_flush(tf);
+    TF_ReleaseTx(tf);
+#else
+    (void) tf;
+#endif
+    return true;
+}
+
 //endregion Sending API funcs - multipart
 
 
-/** Timebase hook - for timeouts */
-void _TF_FN TF_Tick(TinyFrame *tf)
+/** Advance the timer wheel by one tick and expire ID listeners */
+static void _TF_FN tw_tick(TinyFrame *tf)
 {
-    TF_COUNT i;
+    TF_COUNT slot;
+    uint8_t level;
+    uint8_t bucket;
+    uint32_t now;
     struct TF_IdListener_ *lst;
 
+    now = ++tf->ticks;
+
+    // entering the next bucket of a higher level - move its listeners down
+    for (level = 1; level < TF_TW_LEVELS; level++) {
+        if (((now >> (TF_TW_BITS * (level - 1))) & TW_MASK) != 0) break;
+        tw_cascade(tf, (uint8_t) (level * TF_TW_SIZE + ((now >> (TF_TW_BITS * level)) & TW_MASK)));
+    }
+
+    // everything in the level 0 bucket expires now. Move the listeners aside first,
+    // the timeout callbacks may add, renew or remove other listeners.
+    bucket = (uint8_t) (now & TW_MASK);
+    slot = tf->tw_buckets[bucket];
+    tf->tw_buckets[bucket] = 0;
+    tf->tw_buckets[TW_EXPIRING] = slot;
+    while (slot != 0) {
+        ID_LST(tf, slot - 1)->tw_bucket = TW_EXPIRING;
+        slot = ID_LST(tf, slot - 1)->tw_next;
+    }
+
+    listeners_hold(tf);
+    while ((slot = tf->tw_buckets[TW_EXPIRING]) != 0) {
+        lst = ID_LST(tf, slot - 1);
+        tw_unlink(tf, (TF_COUNT) (slot - 1));
+
+        TF_Error("ID listener %d has expired", (int)lst->id);
+        if (lst->fn_timeout != NULL) {
+            lst->fn_timeout(tf); // execute timeout function
+        }
+        // Listener has expired
+        cleanup_id_listener(tf, (TF_COUNT) (slot - 1), lst);
+    }
+    listeners_unhold(tf);
+}
+
+/** Age the frames in the coalescing buffer and flush them if they've waited long enough */
+static void _TF_FN txq_tick(TinyFrame *tf, uint32_t n)
+{
+#if TF_TX_COALESCE && TF_TX_FLUSH_TICKS
+    if (!tx_try_claim(tf)) return; // a frame is being sent, check again on the next tick
+
+    if (tf->txq_len > 0) {
+        if (n >= TF_TX_FLUSH_TICKS - tf->txq_age) {
+            txq_flush(tf);
+        } else {
+            tf->txq_age += n;
+        }
+    }
+    TF_ReleaseTx(tf);
+#else
+    (void) tf;
+    (void) n;
+#endif
+}
+
+/** Timebase hook - for timeouts */
+void _TF_FN TF_Tick(TinyFrame *tf)
+{
     // increment parser timeout (timeout is handled when receiving next byte)
     if (tf->parser_timeout_ticks < TF_PARSER_TIMEOUT_TICKS) {
         tf->parser_timeout_ticks++;
     }
 
-    // decrement and expire ID listeners
-    for (i = 0; i < tf->count_id_lst; i++) {
-        lst = &tf->id_listeners[i];
-        if (!lst->fn || lst->timeout == 0) continue;
-        // count down...
-        if (--lst->timeout == 0) {
-            TF_Error("ID listener %d has expired", (int)lst->id);
-            if (lst->fn_timeout != NULL) {
-                lst->fn_timeout(tf); // execute timeout function
-            }
-            // Listener has expired
-            cleanup_id_listener(tf, i, lst);
+    tw_tick(tf);
+    txq_tick(tf, 1);
+}
+
+/** Advance the timebase by multiple ticks */
+void _TF_FN TF_TickN(TinyFrame *tf, TF_TICKS n)
+{
+    uint32_t left = n;
+    uint32_t next;
+
+    if ((uint32_t) (TF_PARSER_TIMEOUT_TICKS - tf->parser_timeout_ticks) > left) {
+        tf->parser_timeout_ticks = (TF_TICKS) (tf->parser_timeout_ticks + left);
+    } else {
+        tf->parser_timeout_ticks = TF_PARSER_TIMEOUT_TICKS;
+    }
+
+    // skip over the ticks that have nothing to expire or move in the timer wheel
+    while (left > 0) {
+        next = tw_next_event(tf, NULL);
+        if (next == 0 || next > left) {
+            tf->ticks += left;
+            break;
+        }
+
+        tf->ticks += next - 1;
+        left -= next;
+        tw_tick(tf);
+    }
+
+    txq_tick(tf, n);
+}
+
+/** Get the number of ticks until the next timeout */
+TF_TICKS _TF_FN TF_NextDeadline(TinyFrame *tf)
+{
+    uint32_t next;
+    uint32_t parser;
+#if TF_TX_COALESCE && TF_TX_FLUSH_TICKS
+    uint32_t flush;
+#endif
+
+    tw_next_event(tf, &next);
+
+    if (tf->state != TFState_SOF && tf->parser_timeout_ticks < TF_PARSER_TIMEOUT_TICKS) {
+        parser = (uint32_t) (TF_PARSER_TIMEOUT_TICKS - tf->parser_timeout_ticks);
+        if (next == 0 || parser < next) {
+            next = parser;
+        }
+    }
+
+#if TF_TX_COALESCE && TF_TX_FLUSH_TICKS
+    if (tx_try_claim(tf)) {
+        flush = (tf->txq_len > 0) ? TF_TX_FLUSH_TICKS - tf->txq_age : 0;
+        TF_ReleaseTx(tf);
+
+        if (flush != 0 && (next == 0 || flush < next)) {
+            next = flush;
         }
     }
+#endif
+
+    return (TF_TICKS) next;
 }
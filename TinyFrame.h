@@ -25,12 +25,74 @@
 #define TF_CKSUM_CRC8  9  // Dallas/Maxim CRC8 (1-wire)
 #define TF_CKSUM_CRC16 16 // CRC16 with the polynomial 0x8005 (x^16 + x^15 + x^2 + 1)
 #define TF_CKSUM_CRC32 32 // CRC32 with the polynomial 0xedb88320
+#define TF_CKSUM_CRC32C 33 // CRC32C (Castagnoli) with the polynomial 0x82f63b78, uses SSE4.2 if available
+#define TF_CKSUM_CRC   4  // CRC with parameters set in the config (TF_CRC_WIDTH, TF_CRC_POLY, ...)
 #define TF_CKSUM_CUSTOM8  1  // Custom 8-bit checksum
 #define TF_CKSUM_CUSTOM16 2  // Custom 16-bit checksum
 #define TF_CKSUM_CUSTOM32 3  // Custom 32-bit checksum
 
 #include "TF_Config.h"
 
+//region Defaults for optional config
+
+#ifndef TF_USE_ZEROCOPY_RX
+    #define TF_USE_ZEROCOPY_RX 0
+#endif
+
+#ifndef TF_CKSUM_SLICE8
+    #define TF_CKSUM_SLICE8 0
+#endif
+
+#ifndef TF_CKSUM_CLMUL
+    #define TF_CKSUM_CLMUL 1
+#endif
+
+#ifndef TF_DYNAMIC_LISTENERS
+    #define TF_DYNAMIC_LISTENERS 0
+#endif
+
+#ifndef TF_LISTENER_SLAB
+    #define TF_LISTENER_SLAB 16
+#endif
+
+#ifndef TF_USE_WRITEV
+    #define TF_USE_WRITEV 0
+#endif
+
+#ifndef TF_TX_COALESCE
+    #define TF_TX_COALESCE 0
+#endif
+
+#ifndef TF_TX_FLUSH_TICKS
+    #define TF_TX_FLUSH_TICKS 1
+#endif
+
+#ifndef TF_TX_NONBLOCK
+    #define TF_TX_NONBLOCK 0
+#endif
+
+#ifndef TF_USE_FRAGMENTS
+    #define TF_USE_FRAGMENTS 0
+#endif
+
+#ifndef TF_FRAG_TYPE
+    #define TF_FRAG_TYPE 0xFF
+#endif
+
+#ifndef TF_FRAG_LEN
+    #define TF_FRAG_LEN 256
+#endif
+
+#ifndef TF_FRAG_MAX_RX
+    #define TF_FRAG_MAX_RX 1024
+#endif
+
+#if TF_TX_NONBLOCK && TF_USE_WRITEV
+    #error TF_TX_NONBLOCK cannot be used with TF_USE_WRITEV
+#endif
+
+//endregion
+
 //region Resolve data types
 
 #if TF_LEN_BYTES == 1
@@ -72,13 +134,63 @@
 #elif (TF_CKSUM_TYPE == TF_CKSUM_CRC16) || (TF_CKSUM_TYPE == TF_CKSUM_CUSTOM16)
     // CRC16
     typedef uint16_t TF_CKSUM;
-#elif (TF_CKSUM_TYPE == TF_CKSUM_CRC32) || (TF_CKSUM_TYPE == TF_CKSUM_CUSTOM32)
+#elif (TF_CKSUM_TYPE == TF_CKSUM_CRC32) || (TF_CKSUM_TYPE == TF_CKSUM_CRC32C) || (TF_CKSUM_TYPE == TF_CKSUM_CUSTOM32)
     // CRC32
     typedef uint32_t TF_CKSUM;
+#elif TF_CKSUM_TYPE == TF_CKSUM_CRC
+    #ifndef TF_CRC_INIT
+        #define TF_CRC_INIT 0
+    #endif
+    #ifndef TF_CRC_REFLECT
+        #define TF_CRC_REFLECT 0
+    #endif
+    #ifndef TF_CRC_XOROUT
+        #define TF_CRC_XOROUT 0
+    #endif
+    #if TF_CRC_WIDTH == 8
+        typedef uint8_t TF_CKSUM;
+    #elif TF_CRC_WIDTH == 16
+        typedef uint16_t TF_CKSUM;
+    #elif TF_CRC_WIDTH == 32
+        typedef uint32_t TF_CKSUM;
+    #else
+        #error Bad value of TF_CRC_WIDTH, must be 8, 16 or 32
+    #endif
 #else
     #error Bad value for TF_CKSUM_TYPE
 #endif
 
+// Length of the checksum fields in a frame
+#if TF_CKSUM_TYPE == TF_CKSUM_NONE
+    #define TF_CKSUM_BYTES 0
+#else
+    #define TF_CKSUM_BYTES sizeof(TF_CKSUM)
+#endif
+
+#if TF_USE_SOF_BYTE
+    #define TF_SOF_BYTES 1
+#else
+    #define TF_SOF_BYTES 0
+#endif
+
+/** Length of a whole frame with a payload of the given length */
+#define TF_FRAME_LEN(len) ((uint32_t) (TF_SOF_BYTES + TF_ID_BYTES + TF_LEN_BYTES + TF_TYPE_BYTES + TF_CKSUM_BYTES \
+                                       + (len) + ((len) > 0 ? TF_CKSUM_BYTES : 0)))
+
+/** Length of the fragment header - original type, total length and offset */
+#define TF_FRAG_HEAD_BYTES (TF_TYPE_BYTES + TF_LEN_BYTES + TF_LEN_BYTES)
+
+#if TF_USE_FRAGMENTS && TF_LEN_BYTES == 1 && (TF_FRAG_LEN + TF_FRAG_HEAD_BYTES > 255)
+    #error TF_FRAG_LEN is too long for 1-byte TF_LEN
+#endif
+
+// Built-in checksums can be computed in parts and combined (see TF_CksumCombine)
+#if (TF_CKSUM_TYPE == TF_CKSUM_CUSTOM8) || (TF_CKSUM_TYPE == TF_CKSUM_CUSTOM16) || (TF_CKSUM_TYPE == TF_CKSUM_CUSTOM32)
+    #define TF_CKSUM_COMBINE 0
+#else
+    #define TF_CKSUM_COMBINE 1
+#endif
+
 //endregion
 
 //---------------------------------------------------------------------------
@@ -99,6 +211,14 @@ typedef enum {
 } TF_Result;
 
 
+/** Result of TF_TrySend() */
+typedef enum {
+    TF_TX_OK = 0,         //!< Sent, or stored in the outbound buffer to be sent
+    TF_TX_WOULDBLOCK = 1, //!< No room in the outbound buffer (TF_TX_NONBLOCK), try again after TF_OnWritable()
+    TF_TX_FAIL = 2,       //!< Tx interface not claimed, ID listener not added, or the frame is too long
+} TF_TxResult;
+
+
 /** Data structure for sending / receiving messages */
 typedef struct TF_Msg_ {
     TF_ID frame_id;       //!< message ID
@@ -113,6 +233,9 @@ typedef struct TF_Msg_ {
      *
      * - If (data == NULL) and length is not zero when sending a frame, that starts a multi-part frame.
      *   This call then must be followed by sending the payload and closing the frame.
+     *
+     * - Received data is only valid until the listener returns. With TF_USE_ZEROCOPY_RX,
+     *   it may point into the buffer given to TF_Accept().
      */
     const uint8_t *data;
     TF_LEN len; //!< length of the payload
@@ -127,6 +250,21 @@ typedef struct TF_Msg_ {
     void *userdata2;
 } TF_Msg;
 
+/** Frame of a fixed type and length composed in advance, see TF_InitTemplate() */
+typedef struct TF_FrameTemplate_ {
+    uint8_t head[TF_FRAME_LEN(0)]; //!< Composed header - ID and header checksum are filled in when sending
+    TF_CKSUM head_cksum;  //!< Header checksum up to the ID field
+    TF_LEN len;           //!< Payload length
+    const uint8_t *data;  //!< Constant payload, or NULL
+    TF_CKSUM data_cksum;  //!< Checksum of the constant payload (not finalized)
+} TF_FrameTemplate;
+
+/** A piece of an outgoing frame, passed to TF_WriteVImpl() */
+typedef struct TF_IoVec_ {
+    const uint8_t *data;
+    uint32_t len;
+} TF_IoVec;
+
 
 #ifdef __cplusplus
 extern "C" {
@@ -163,6 +301,27 @@ typedef TF_Result (*TF_Listener)(TinyFrame *tf, TF_Msg *msg);
  */
 typedef TF_Result (*TF_Listener_Timeout)(TinyFrame *tf);
 
+/** Events passed to a stream listener, in the order they happen for each frame */
+typedef enum {
+    TF_STREAM_BEGIN = 0,  //!< Payload is starting. msg->len is the total payload length, msg->data is NULL
+    TF_STREAM_DATA = 1,   //!< A piece of the payload in msg->data, msg->len. Not verified yet!
+    TF_STREAM_END = 2,    //!< The whole payload was received and the checksum is OK
+    TF_STREAM_ABORT = 3,  //!< Checksum mismatch or parser reset - discard the received pieces
+} TF_StreamEvent;
+
+/**
+ * TinyFrame Stream Listener callback
+ *
+ * Receives frames longer than TF_MAX_PAYLOAD_RX piece by piece.
+ *
+ * @param tf - instance
+ * @param msg - frame ID and type of the frame, payload info depends on the event
+ * @param event - what happened
+ * @return listener result. TF_NEXT returned for TF_STREAM_BEGIN rejects the frame,
+ *         the result is ignored for the other events.
+ */
+typedef TF_Result (*TF_StreamListener)(TinyFrame *tf, TF_Msg *msg, TF_StreamEvent event);
+
 // ---------------------------------- INIT ------------------------------
 
 /**
@@ -187,6 +346,11 @@ TinyFrame *TF_Init(TF_Peer peer_bit);
  *
  * The .userdata / .usertag field is preserved when TF_InitStatic is called.
  *
+ * With TF_DYNAMIC_LISTENERS, re-initializing an instance frees the listeners of
+ * the previous run. The struct must then be zeroed before it's initialized the first
+ * time - static variables are, one on the stack or from malloc() has to be cleared
+ * (memset or "= {0}"). Otherwise leftover bytes could be taken for listener memory.
+ *
  * @param tf - instance
  * @param peer_bit - peer bit to use for self
  * @return success
@@ -196,16 +360,33 @@ bool TF_InitStatic(TinyFrame *tf, TF_Peer peer_bit);
 /**
  * De-init the dynamically allocated TF instance
  *
+ * With TF_DYNAMIC_LISTENERS, this also frees the memory of all listeners.
+ * Use TF_DeInitStatic() for instances set up with TF_InitStatic().
+ *
  * @param tf - instance
  */
 void TF_DeInit(TinyFrame *tf);
 
+/**
+ * De-init a TF instance set up with TF_InitStatic(), without freeing the struct.
+ *
+ * With TF_DYNAMIC_LISTENERS, this frees the memory of all listeners. Otherwise
+ * there's nothing to release. The instance can be initialized again afterwards.
+ *
+ * @param tf - instance
+ */
+void TF_DeInitStatic(TinyFrame *tf);
+
 
 // ---------------------------------- API CALLS --------------------------------------
 
 /**
  * Accept incoming bytes & parse frames
  *
+ * Payload bytes and complete headers are consumed in bulk, so passing larger
+ * buffers is much faster than calling TF_AcceptChar() for each byte.
+ * The parse results are the same either way.
+ *
  * @param tf - instance
  * @param buffer - byte buffer to process
  * @param count - nr of bytes in the buffer
@@ -225,6 +406,8 @@ void TF_AcceptChar(TinyFrame *tf, uint8_t c);
  * The time base is used to time-out partial frames in the parser and
  * automatically reset it.
  * It's also used to expire ID listeners if a timeout is set when registering them.
+ * Listeners that don't expire in the tick are not visited, so this is cheap to call
+ * often even with many waiting listeners.
  *
  * A common place to call this from is the SysTick handler.
  *
@@ -232,6 +415,28 @@ void TF_AcceptChar(TinyFrame *tf, uint8_t c);
  */
 void TF_Tick(TinyFrame *tf);
 
+/**
+ * Advance the time base by n ticks at once, as if TF_Tick() was called n times.
+ * Use this with TF_NextDeadline() to avoid waking up for every tick.
+ *
+ * @param tf - instance
+ * @param n - number of ticks that passed
+ */
+void TF_TickN(TinyFrame *tf, TF_TICKS n);
+
+/**
+ * Get the number of ticks until the next timeout - of an ID listener, of the
+ * parser waiting for the rest of a frame, or of frames waiting in the coalescing
+ * buffer (TF_TX_COALESCE). Until then, TF_Tick() has nothing to do and the
+ * application may sleep, then catch up using TF_TickN().
+ *
+ * Adding or renewing listeners and receiving data can bring the deadline closer.
+ *
+ * @param tf - instance
+ * @return ticks until the next timeout, 0 if there's none
+ */
+TF_TICKS TF_NextDeadline(TinyFrame *tf);
+
 /**
  * Reset the frame parser state machine.
  * This does not affect registered listeners.
@@ -252,6 +457,10 @@ void TF_ResetParser(TinyFrame *tf);
  * @param ftimeout - time out callback
  * @param timeout - timeout in ticks to auto-remove the listener (0 = keep forever)
  * @return slot index (for removing), or TF_ERROR (-1)
+ *
+ * If there are more listeners for the same frame ID (e.g. one left without a timeout
+ * from before the IDs wrapped around), the most recently added one gets the frame
+ * first. TF_RemoveIdListener() and TF_RenewIdListener() also act on that one.
  */
 bool TF_AddIdListener(TinyFrame *tf, TF_Msg *msg, TF_Listener cb, TF_Listener_Timeout ftimeout, TF_TICKS timeout);
 
@@ -298,6 +507,19 @@ bool TF_AddGenericListener(TinyFrame *tf, TF_Listener cb);
  */
 bool TF_RemoveGenericListener(TinyFrame *tf, TF_Listener cb);
 
+/**
+ * Set the stream listener, receiving frames too long for the receive buffer.
+ *
+ * Without a stream listener, such frames are discarded. With it, the listener
+ * is given the payload in pieces as they arrive (at most TF_MAX_PAYLOAD_RX bytes
+ * each), followed by the checksum verdict. The frame does not go to the other
+ * listeners then.
+ *
+ * @param tf - instance
+ * @param cb - callback, NULL to remove the stream listener
+ */
+void TF_SetStreamListener(TinyFrame *tf, TF_StreamListener cb);
+
 /**
  * Renew an ID listener timeout externally (as opposed to by returning TF_RENEW from the ID listener)
  *
@@ -353,6 +575,172 @@ bool TF_QuerySimple(TinyFrame *tf, TF_TYPE type,
  */
 bool TF_Respond(TinyFrame *tf, TF_Msg *msg);
 
+/**
+ * Send several frames at once. The Tx interface is claimed only once, and the frames are
+ * collected in the Tx buffer and written together - when it's full and at the end.
+ * Make TF_SENDBUF_LEN large enough for the whole batch to write it in one call.
+ *
+ * Sending stops at the first frame that can't be sent (e.g. with TF_TX_NONBLOCK, when the
+ * outbound buffer is full). Multi-part frames (data NULL) can't be sent in a batch.
+ *
+ * @param tf - instance
+ * @param msgs - array of messages. IDs are stored in their frame_id fields
+ * @param count - number of messages
+ * @return number of frames sent, from the start of msgs
+ */
+uint32_t TF_SendBatch(TinyFrame *tf, TF_Msg *msgs, uint32_t count);
+
+/**
+ * Like TF_SendBatch(), but an ID listener is added for each frame, with the
+ * userdata from its message.
+ *
+ * @param tf - instance
+ * @param msgs - array of messages. IDs are stored in their frame_id fields
+ * @param count - number of messages
+ * @param listener - listener waiting for the responses
+ * @param ftimeout - time out callback
+ * @param timeout - listener expiry time in ticks
+ * @return number of frames sent, from the start of msgs
+ */
+uint32_t TF_QueryBatch(TinyFrame *tf, TF_Msg *msgs, uint32_t count, TF_Listener listener,
+                       TF_Listener_Timeout ftimeout, TF_TICKS timeout);
+
+/**
+ * Send a frame, and optionally attach an ID listener, reporting why it wasn't sent.
+ * This is TF_Query() (or TF_Send() with listener NULL).
+ *
+ * With TF_TX_NONBLOCK, a frame is only sent if there's room for all of it in the outbound
+ * buffer. Otherwise, TF_TX_WOULDBLOCK is returned and nothing is sent - wait until the
+ * transport can accept more data, call TF_OnWritable() and try again. The other sending
+ * functions return false in this case.
+ *
+ * @param tf - instance
+ * @param msg - message struct. ID is stored in the frame_id field
+ * @param listener - listener waiting for the response (can be NULL)
+ * @param ftimeout - time out callback
+ * @param timeout - listener expiry time in ticks
+ * @return result
+ */
+TF_TxResult TF_TrySend(TinyFrame *tf, TF_Msg *msg, TF_Listener listener,
+                       TF_Listener_Timeout ftimeout, TF_TICKS timeout);
+
+/**
+ * Write out the outbound buffer (TF_TX_NONBLOCK), as much of it as TF_TryWriteImpl()
+ * accepts. Call this when the transport can accept more data.
+ *
+ * If a frame is being sent at the same time (from another thread, or this is called
+ * from a listener during a send), nothing is written and 0 is returned. Check
+ * TF_TxPending() again after the send is done.
+ *
+ * @param tf - instance
+ * @return number of bytes still waiting in the buffer
+ */
+uint32_t TF_OnWritable(TinyFrame *tf);
+
+/**
+ * Get the number of bytes in the outbound buffer (TF_TX_NONBLOCK), waiting for the
+ * transport to accept them. If not 0, TF_OnWritable() should be called when it can.
+ * Frames collected by TF_TX_COALESCE are not counted.
+ *
+ * The count is read with the Tx interface claimed. If a frame is being sent at the
+ * same time, 0 is returned - the sender's TF_Send() / TF_TrySend() call is the one
+ * to check it after.
+ *
+ * @param tf - instance
+ * @return number of bytes
+ */
+uint32_t TF_TxPending(TinyFrame *tf);
+
+/**
+ * Compose a whole frame into a buffer provided by the caller, without sending it.
+ * Many frames can be composed one after another in a large buffer (or shared memory etc.)
+ * and written out by the application at once, TF_WriteImpl() is not used.
+ *
+ * The Tx interface is not claimed. Frame IDs are taken from the instance the same way
+ * as when sending - atomically with GCC / clang on targets with lock-free atomics of
+ * the size of TF_ID. Elsewhere (e.g. Cortex-M0, AVR), don't compose frames of one
+ * instance from several threads at once.
+ * Set msg->is_response to compose a response with the ID from msg->frame_id.
+ * ID listeners can't be attached - use TF_AddIdListener() with the ID put into msg.
+ *
+ * @param tf - instance
+ * @param msg - message to compose, the frame ID is stored in its frame_id field
+ * @param outbuff - buffer to compose the frame in
+ * @param capacity - size of the buffer, at least TF_FRAME_LEN(msg->len)
+ * @return number of bytes used in outbuff, 0 if the frame doesn't fit or msg->data is missing
+ *         (no ID is taken then)
+ */
+uint32_t TF_ComposeFrame(TinyFrame *tf, TF_Msg *msg, uint8_t *outbuff, uint32_t capacity);
+
+/**
+ * Prepare a template for frames that are sent often with the same type and length,
+ * e.g. periodic telemetry. The header is composed once, sending a frame with
+ * TF_SendTemplate() then only fills in the ID and finishes the header checksum.
+ *
+ * A template doesn't depend on the instance and can be shared by several.
+ *
+ * @param tpl - template to initialize
+ * @param type - message type
+ * @param len - payload length
+ * @param data - constant payload of len bytes, its checksum is computed here once.
+ *               It must stay valid and unchanged. NULL if the payload is given when sending.
+ */
+void TF_InitTemplate(TF_FrameTemplate *tpl, TF_TYPE type, TF_LEN len, const uint8_t *data);
+
+/**
+ * Send a frame using a template prepared by TF_InitTemplate().
+ *
+ * @param tf - instance
+ * @param tpl - template
+ * @param data - payload of tpl->len bytes, NULL to send the template's constant payload
+ * @return success
+ */
+bool TF_SendTemplate(TinyFrame *tf, const TF_FrameTemplate *tpl, const uint8_t *data);
+
+/**
+ * Send a frame composed in a buffer provided by the caller (e.g. on the stack).
+ *
+ * The frame is composed without the Tx interface claimed, it's claimed (TF_ClaimTx)
+ * only to write out the finished frame. Other threads can meanwhile send their frames
+ * and the lock is held for a time independent of the payload length.
+ * Frame IDs are taken the same way as in TF_ComposeFrame(), see there.
+ *
+ * Set msg->is_response to send a response with the ID from msg->frame_id.
+ * ID listeners can't be attached - use TF_AddIdListener() with the ID put into msg.
+ *
+ * @param tf - instance
+ * @param msg - message to send, the frame ID is stored in its frame_id field
+ * @param buf - buffer to compose the frame in
+ * @param cap - size of the buffer, at least TF_FRAME_LEN(msg->len)
+ * @return success - false if the buffer is too small or the Tx interface couldn't be claimed,
+ *                   or (TF_TX_NONBLOCK) the outbound buffer is full. The frame ID is used up then.
+ */
+bool TF_Send_Buffered(TinyFrame *tf, TF_Msg *msg, uint8_t *buf, uint32_t cap);
+
+/**
+ * Begin a frame whose payload is written by the caller directly into the Tx buffer,
+ * e.g. by serializing a struct into it, without an intermediate buffer and copying.
+ *
+ * The header is composed and the Tx interface stays claimed (TF_ClaimTx) until
+ * TF_CommitFrame() is called - it must be called, nothing else can be sent meanwhile.
+ * The whole frame must fit in the Tx buffer: TF_FRAME_LEN(len) <= TF_SENDBUF_LEN.
+ *
+ * @param tf - instance
+ * @param type - message type
+ * @param len - payload length
+ * @return pointer to len bytes for the payload, NULL if the frame doesn't fit,
+ *         the Tx interface couldn't be claimed, or (TF_TX_NONBLOCK) the outbound buffer is full
+ */
+uint8_t *TF_ReserveFrame(TinyFrame *tf, TF_TYPE type, TF_LEN len);
+
+/**
+ * Finish a frame begun by TF_ReserveFrame() - add the payload checksum and send it.
+ * This releases the Tx interface.
+ *
+ * @param tf - instance
+ */
+void TF_CommitFrame(TinyFrame *tf);
+
 
 // ------------------------ MULTIPART FRAME TX FUNCTIONS -----------------------------
 // Those routines are used to send long frames without having all the data available
@@ -396,6 +784,47 @@ void TF_Respond_Multipart(TinyFrame *tf, TF_Msg *msg);
  */
 void TF_Multipart_Payload(TinyFrame *tf, const uint8_t *buff, uint32_t length);
 
+#if TF_CKSUM_COMBINE
+
+/**
+ * Send the payload for a started multipart frame, with a checksum computed beforehand
+ * using TF_CksumPartial() (and TF_CksumCombine(), if the part was checksummed in pieces).
+ *
+ * This allows large payloads to be checksummed in parallel, e.g. by worker threads
+ * each taking one slice, leaving only the copying to this call.
+ *
+ * @param tf - instance
+ * @param buff - buffer to send bytes from
+ * @param length - number of bytes to send
+ * @param cksum - partial checksum of the buffer
+ */
+void TF_Multipart_PayloadCksum(TinyFrame *tf, const uint8_t *buff, uint32_t length, TF_CKSUM cksum);
+
+/**
+ * Compute the partial checksum of a buffer.
+ *
+ * This does not use any instance, so it's safe to call from any thread.
+ * The checksum tables are prepared by TF_Init() / TF_InitStatic(), call that first.
+ *
+ * @param buff - buffer to checksum
+ * @param length - number of bytes
+ * @return partial checksum
+ */
+TF_CKSUM TF_CksumPartial(const uint8_t *buff, uint32_t length);
+
+/**
+ * Combine partial checksums of two adjacent buffers (the second one following the first)
+ * into the partial checksum of both.
+ *
+ * @param cksum1 - partial checksum of the first buffer
+ * @param cksum2 - partial checksum of the second buffer
+ * @param length2 - length of the second buffer
+ * @return partial checksum of both buffers
+ */
+TF_CKSUM TF_CksumCombine(TF_CKSUM cksum1, TF_CKSUM cksum2, uint32_t length2);
+
+#endif // TF_CKSUM_COMBINE
+
 /**
  * Close the multipart message, generating chekcsum and releasing the Tx lock.
  *
@@ -403,6 +832,56 @@ void TF_Multipart_Payload(TinyFrame *tf, const uint8_t *buff, uint32_t length);
  */
 void TF_Multipart_Close(TinyFrame *tf);
 
+/**
+ * Write out the frames waiting in the coalescing buffer.
+ *
+ * With TF_TX_COALESCE, sent frames are collected in a buffer and written together
+ * when it fills up, TF_TX_FLUSH_TICKS ticks after the first of them was sent,
+ * or when this is called. Without it, this does nothing.
+ *
+ * @param tf - instance
+ * @return success (mutex claimed)
+ */
+bool TF_Flush(TinyFrame *tf);
+
+
+// ------------------------ FRAGMENTED MESSAGES -----------------------------
+// A long message is sent as a sequence of frames of type TF_FRAG_TYPE (with TF_USE_FRAGMENTS),
+// each carrying up to TF_FRAG_LEN bytes of it. The Tx interface is claimed for one fragment
+// at a time, so other frames can be sent between them. The receiver reassembles the message
+// and passes it to the listeners as if it came in one frame.
+
+#if TF_USE_FRAGMENTS
+
+/**
+ * Send the next fragment of a message. Call repeatedly until *offset reaches msg->len
+ * (a message with no payload is sent as one empty fragment). Other frames can be sent
+ * between the calls, but not fragments of another message.
+ *
+ * The first fragment takes a frame ID (stored in msg->frame_id), unless msg->is_response
+ * is set. All the fragments use that ID. To wait for a response, add an ID listener
+ * with TF_AddIdListener() after the first fragment.
+ *
+ * @param tf - instance
+ * @param msg - the whole message
+ * @param offset - payload offset of the fragment, start with 0. Moved past the sent bytes.
+ * @return success - false if the Tx interface couldn't be claimed (or the outbound buffer
+ *                   is full with TF_TX_NONBLOCK), *offset is unchanged then
+ */
+bool TF_SendFragment(TinyFrame *tf, TF_Msg *msg, TF_LEN *offset);
+
+/**
+ * Send a message in fragments. Equivalent to calling TF_SendFragment() until it's all sent.
+ * Other threads can send their frames between the fragments.
+ *
+ * @param tf - instance
+ * @param msg - message to send
+ * @return success
+ */
+bool TF_SendFragmented(TinyFrame *tf, TF_Msg *msg);
+
+#endif
+
 
 // ---------------------------------- INTERNAL ----------------------------------
 // This is publicly visible only to allow static init.
@@ -417,18 +896,51 @@ enum TF_State_ {
     TFState_DATA_CKSUM    //!< Wait for Checksum
 };
 
+/** Smallest power of two >= n, at least 16 (for n up to 65536) */
+#define TF_POW2_CEIL(n) ((n) <= 16 ? 16 : (n) <= 32 ? 32 : (n) <= 64 ? 64 : (n) <= 128 ? 128 : \
+                         (n) <= 256 ? 256 : (n) <= 512 ? 512 : (n) <= 1024 ? 1024 : (n) <= 2048 ? 2048 : \
+                         (n) <= 4096 ? 4096 : (n) <= 8192 ? 8192 : (n) <= 16384 ? 16384 : \
+                         (n) <= 32768 ? 32768 : 65536)
+
+// Listener index sizes. 1-byte IDs and types index them directly, wider keys are hashed
+// into a table with at least twice as many entries as there are listener slots.
+// With dynamic listeners, the hash tables are allocated and resized as needed.
+#if TF_ID_BYTES == 1
+    #define TF_ID_INDEX_LEN 256
+#elif !TF_DYNAMIC_LISTENERS
+    #define TF_ID_INDEX_LEN TF_POW2_CEIL(TF_MAX_ID_LST * 2)
+#endif
+
+#if TF_TYPE_BYTES == 1
+    #define TF_TYPE_INDEX_LEN 256
+#elif !TF_DYNAMIC_LISTENERS
+    #define TF_TYPE_INDEX_LEN TF_POW2_CEIL(TF_MAX_TYPE_LST * 2)
+#endif
+
+// Timer wheel for ID listener timeouts. Each level has 16 buckets, each bucket of a level
+// spans 16x more ticks than one of the level below; with 2 levels per byte of TF_TICKS,
+// any timeout fits in the wheel.
+#define TF_TW_BITS 4
+#define TF_TW_SIZE (1 << TF_TW_BITS)
+#define TF_TW_LEVELS (sizeof(TF_TICKS) * 8 / TF_TW_BITS)
+
 struct TF_IdListener_ {
     TF_ID id;
+    TF_COUNT next;        // next listener with the same ID (slot + 1), 0 = none
     TF_Listener fn;
     TF_Listener_Timeout fn_timeout;
-    TF_TICKS timeout;     // nr of ticks remaining to disable this listener
     TF_TICKS timeout_max; // the original timeout is stored here (0 = no timeout)
+    uint32_t expires;     // tick at which the listener times out (if it has a timeout)
+    TF_COUNT tw_next;     // next listener in the same timer wheel bucket (slot + 1), 0 = none
+    TF_COUNT tw_prev;     // previous listener in the bucket (slot + 1), 0 = first
+    uint8_t tw_bucket;    // timer wheel bucket the listener is in, 0xFF = not scheduled
     void *userdata;
     void *userdata2;
 };
 
 struct TF_TypeListener_ {
     TF_TYPE type;
+    TF_COUNT next;        // next listener with the same type (slot + 1), 0 = none
     TF_Listener fn;
 };
 
@@ -436,6 +948,34 @@ struct TF_GenericListener_ {
     TF_Listener fn;
 };
 
+#if TF_DYNAMIC_LISTENERS
+/** Bookkeeping of a slab of listener slots */
+struct TF_Slab_ {
+    TF_COUNT live;        // number of used slots
+    TF_COUNT free;        // first free slot in the slab (index + 1), 0 = full
+    TF_COUNT prev;        // previous slab with free slots (index + 1), 0 = first
+    TF_COUNT next;        // next slab with free slots (index + 1), 0 = none
+    TF_COUNT link[TF_LISTENER_SLAB]; // next free slot after each free slot (index + 1)
+};
+
+/** Listener slots allocated in slabs of TF_LISTENER_SLAB, slot n is in slab n / TF_LISTENER_SLAB */
+struct TF_Pool_ {
+    uint8_t **slabs;        // listener storage of each slab, NULL if released
+    struct TF_Slab_ *info;  // bookkeeping of each slab
+    TF_COUNT len;           // length of the two arrays
+    TF_COUNT partial;       // first slab with free slots (index + 1), 0 = all full
+    TF_COUNT empty;         // number of slabs with no listeners that are kept allocated
+};
+
+/** Resizable listener index hash table */
+struct TF_Index_ {
+    TF_COUNT *heads;        // slot + 1 of the first listener for the key, 0 = empty
+    uint32_t *keys;         // key of each used entry
+    uint32_t len;           // number of entries, a power of two (or 0 before the first use)
+    uint32_t used;          // number of used entries
+};
+#endif
+
 /**
  * Frame parser internal state.
  */
@@ -456,11 +996,25 @@ struct TinyFrame_ {
     TF_ID id;               //!< Incoming packet ID
     TF_LEN len;             //!< Payload length
     uint8_t data[TF_MAX_PAYLOAD_RX]; //!< Data byte buffer
+#if TF_USE_ZEROCOPY_RX
+    const uint8_t *data_ext; //!< Payload in the buffer passed to TF_Accept (if not copied to 'data')
+#endif
     TF_LEN rxi;             //!< Field size byte counter
     TF_CKSUM cksum;         //!< Checksum calculated of the data stream
     TF_CKSUM ref_cksum;     //!< Reference checksum read from the message
     TF_TYPE type;           //!< Collected message type number
     bool discard_data;      //!< Set if (len > TF_MAX_PAYLOAD) to read the frame, but ignore the data.
+    bool streaming;         //!< Set if the frame is being passed to the stream listener
+    TF_LEN chunk_len;       //!< Payload bytes waiting in the data buffer for the stream listener
+
+#if TF_USE_FRAGMENTS
+    uint8_t frag_buf[TF_FRAG_MAX_RX]; //!< Fragmented message being reassembled
+    bool frag_active;       //!< Set if fragments are being collected in frag_buf
+    TF_ID frag_id;          //!< Frame ID of the fragments
+    TF_TYPE frag_type;      //!< Type of the reassembled message
+    TF_LEN frag_len;        //!< Total length of the message
+    TF_LEN frag_pos;        //!< Number of bytes received
+#endif
 
     /* Tx state */
     // Buffer for building frames
@@ -470,6 +1024,18 @@ struct TinyFrame_ {
     uint32_t tx_len;        //!< Total expected Tx length
     TF_CKSUM tx_cksum;      //!< Transmit checksum accumulator
 
+#if TF_TX_COALESCE
+    uint8_t txq[TF_TX_COALESCE]; //!< Sent frames waiting to be written together
+    uint32_t txq_len;       //!< Number of bytes in txq
+    uint32_t txq_age;       //!< Ticks the first of them has waited
+#endif
+
+#if TF_TX_NONBLOCK
+    uint8_t txr[TF_TX_NONBLOCK]; //!< Outbound ring - bytes the transport didn't accept yet
+    uint32_t txr_pos;       //!< Position of the first byte in txr
+    uint32_t txr_len;       //!< Number of bytes in txr
+#endif
+
 #if !TF_USE_MUTEX
     bool soft_lock;         //!< Tx lock flag used if the mutex feature is not enabled.
 #endif
@@ -477,13 +1043,55 @@ struct TinyFrame_ {
     /* --- Callbacks --- */
 
     /* Transaction callbacks */
+#if TF_DYNAMIC_LISTENERS
+    struct TF_Pool_ id_pool;
+    struct TF_Pool_ type_pool;
+    struct TF_GenericListener_ *generic_listeners;
+    TF_COUNT generic_cap;   //!< Allocated length of generic_listeners
+    uint32_t lst_mark;      //!< TF_LST_MARK while the instance owns the listener memory
+#else
     struct TF_IdListener_ id_listeners[TF_MAX_ID_LST];
     struct TF_TypeListener_ type_listeners[TF_MAX_TYPE_LST];
     struct TF_GenericListener_ generic_listeners[TF_MAX_GEN_LST];
+    // Free slots are chained through their 'next' field (slot + 1, 0 = none)
+    TF_COUNT id_free;
+    TF_COUNT type_free;
+#endif
+    TF_StreamListener stream_listener;
+    uint8_t lst_busy;       //!< Listener callbacks are running - removed generic listeners
+                            //!< are only compacted (and unused memory released) after that
+    bool generic_holes;     //!< Some generic listeners were removed while callbacks ran
+    TF_COUNT id_dead;       //!< ID listeners removed while callbacks ran, released after that
+                            //!< (slot + 1, chained through tw_next, 0 = none)
+
+    // ID listeners by frame ID: slot + 1 of the first listener for the ID, 0 = none
+#if TF_ID_BYTES == 1
+    TF_COUNT id_index[TF_ID_INDEX_LEN];
+#elif TF_DYNAMIC_LISTENERS
+    struct TF_Index_ id_index;
+#else
+    TF_COUNT id_index[TF_ID_INDEX_LEN];
+    uint32_t id_index_key[TF_ID_INDEX_LEN]; // frame ID of each used id_index entry
+#endif
 
-    // Those counters are used to optimize look-up times.
-    // They point to the highest used slot number,
-    // or close to it, depending on the removal order.
+    // Type listeners by frame type: slot + 1 of the first listener for the type, 0 = none
+#if TF_TYPE_BYTES == 1
+    TF_COUNT type_index[TF_TYPE_INDEX_LEN];
+#elif TF_DYNAMIC_LISTENERS
+    struct TF_Index_ type_index;
+#else
+    TF_COUNT type_index[TF_TYPE_INDEX_LEN];
+    uint32_t type_index_key[TF_TYPE_INDEX_LEN]; // frame type of each used type_index entry
+#endif
+
+    uint32_t ticks;         //!< Number of TF_Tick() calls, wraps around
+
+    // ID listener timeouts: slot + 1 of the first listener in each timer wheel bucket,
+    // the last entry holds listeners that are being expired by TF_Tick()
+    TF_COUNT tw_buckets[TF_TW_LEVELS * TF_TW_SIZE + 1];
+
+    // Numbers of registered listeners. Generic listeners are kept at the start
+    // of their table in the order they were added.
     TF_COUNT count_id_lst;
     TF_COUNT count_type_lst;
     TF_COUNT count_generic_lst;
@@ -499,6 +1107,23 @@ struct TinyFrame_ {
  */
 extern void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len);
 
+#if TF_USE_WRITEV
+
+    /**
+     * 'Write bytes' function taking a list of buffers (like writev()). With TF_USE_WRITEV,
+     * it's used instead of TF_WriteImpl() - that one doesn't need to be implemented then.
+     *
+     * A frame sent in one call (e.g. TF_Send) is passed in a single call as the header,
+     * the user's payload buffer (not copied) and the checksum. Empty pieces are left out.
+     *
+     * @param tf - instance
+     * @param iov - pieces to send, in order
+     * @param iovcnt - number of pieces (1-3)
+     */
+    extern void TF_WriteVImpl(TinyFrame *tf, const TF_IoVec *iov, uint8_t iovcnt);
+
+#endif
+
 // Mutex functions
 #if TF_USE_MUTEX
 
@@ -510,6 +1135,24 @@ extern void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len);
 
 #endif
 
+#if TF_TX_NONBLOCK
+
+    /**
+     * Non-blocking 'write bytes' function. With TF_TX_NONBLOCK, it's used instead of
+     * TF_WriteImpl() - that one doesn't need to be implemented then.
+     *
+     * Write as much as the transport accepts without waiting. The rest is kept
+     * by TinyFrame and passed again from TF_OnWritable().
+     *
+     * @param tf - instance
+     * @param buff - bytes to write
+     * @param len - number of bytes
+     * @return number of bytes accepted (0 to len)
+     */
+    extern uint32_t TF_TryWriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len);
+
+#endif
+
 // Custom checksum functions
 #if (TF_CKSUM_TYPE == TF_CKSUM_CUSTOM8) || (TF_CKSUM_TYPE == TF_CKSUM_CUSTOM16) || (TF_CKSUM_TYPE == TF_CKSUM_CUSTOM32)
 
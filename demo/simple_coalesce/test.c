@@ -0,0 +1,122 @@
+//
+// The coalescing buffer is flushed TF_TX_FLUSH_TICKS ticks after its first frame,
+// also when frames are sent from one thread and TF_Tick() runs in another.
+// Built with ThreadSanitizer.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "../../TinyFrame.h"
+#include "../utils.h"
+
+#define SENDER_FRAMES 2000
+
+static TinyFrame demo_tf;
+static pthread_mutex_t tx_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t written; // only changed with the Tx interface claimed
+
+bool TF_ClaimTx(TinyFrame *tf)
+{
+    (void) tf;
+    pthread_mutex_lock(&tx_mutex);
+    return true;
+}
+
+void TF_ReleaseTx(TinyFrame *tf)
+{
+    (void) tf;
+    pthread_mutex_unlock(&tx_mutex);
+}
+
+void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len)
+{
+    (void) tf;
+    (void) buff;
+    written += len;
+}
+
+static uint32_t getWritten(void)
+{
+    uint32_t n;
+    pthread_mutex_lock(&tx_mutex);
+    n = written;
+    pthread_mutex_unlock(&tx_mutex);
+    return n;
+}
+
+static void sendOne(void)
+{
+    TF_Msg msg;
+    TF_ClearMsg(&msg);
+    msg.type = 0x22;
+    msg.data = (pu8) "Hello";
+    msg.len = 6;
+    TF_Send(&demo_tf, &msg);
+}
+
+static void *senderThread(void *arg)
+{
+    int i;
+    (void) arg;
+    for (i = 0; i < SENDER_FRAMES; i++) {
+        sendOne();
+    }
+    return NULL;
+}
+
+static int checkDeadline(void)
+{
+    int i;
+
+    sendOne();
+    if (getWritten() != 0 || TF_NextDeadline(&demo_tf) != TF_TX_FLUSH_TICKS) {
+        printf("FAIL - frame not held for %d ticks\n", TF_TX_FLUSH_TICKS);
+        return 1;
+    }
+
+    for (i = 1; i < TF_TX_FLUSH_TICKS; i++) {
+        TF_Tick(&demo_tf);
+        sendOne(); // frames sent later don't move the deadline
+    }
+    if (getWritten() != 0 || TF_NextDeadline(&demo_tf) != 1) {
+        printf("FAIL - flushed too early\n");
+        return 1;
+    }
+
+    TF_Tick(&demo_tf);
+    if (getWritten() != TF_FRAME_LEN(6) * TF_TX_FLUSH_TICKS || TF_NextDeadline(&demo_tf) != 0) {
+        printf("FAIL - not flushed after %d ticks\n", TF_TX_FLUSH_TICKS);
+        return 1;
+    }
+
+    // TF_TickN() over the whole deadline at once
+    sendOne();
+    TF_TickN(&demo_tf, TF_TX_FLUSH_TICKS + 10);
+    if (getWritten() != TF_FRAME_LEN(6) * (TF_TX_FLUSH_TICKS + 1)) {
+        printf("FAIL - not flushed by TF_TickN()\n");
+        return 1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    pthread_t sender;
+
+    TF_InitStatic(&demo_tf, TF_MASTER);
+    if (checkDeadline()) return 1;
+    printf("OK - flush deadline\n");
+
+    // Send from another thread while this one ticks, ThreadSanitizer reports any race
+    written = 0;
+    pthread_create(&sender, NULL, senderThread, NULL);
+    while (getWritten() < TF_FRAME_LEN(6) * SENDER_FRAMES) {
+        TF_Tick(&demo_tf);
+        TF_NextDeadline(&demo_tf);
+    }
+    pthread_join(sender, NULL);
+
+    printf("OK - sent from one thread, ticked from another\n");
+    return 0;
+}
@@ -0,0 +1,155 @@
+//
+// Remove ID listeners from inside their own callbacks, then check the listener
+// tables still work. Built with AddressSanitizer.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include "../../TinyFrame.h"
+#include "../utils.h"
+
+static TinyFrame demo_tf;
+
+static int cleanups;
+static int timeouts;
+static int called;
+
+/** Frames are not looped back, the listeners are only triggered by the tests */
+void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len)
+{
+    (void) tf;
+    (void) buff;
+    (void) len;
+}
+
+/** Removes its own listener again when asked to clean up (msg->data is NULL) */
+TF_Result selfRemovingListener(TinyFrame *tf, TF_Msg *msg)
+{
+    if (msg->data == NULL) {
+        cleanups++;
+        TF_RemoveIdListener(tf, *(TF_ID *) msg->userdata);
+    }
+    return TF_CLOSE;
+}
+
+TF_Result plainListener(TinyFrame *tf, TF_Msg *msg)
+{
+    (void) tf;
+    (void) msg;
+    return TF_CLOSE;
+}
+
+TF_Result countTimeout(TinyFrame *tf)
+{
+    (void) tf;
+    timeouts++;
+    return TF_CLOSE;
+}
+
+/** Called first of the listeners for the frame, removes itself and the next one */
+TF_Result removeTwoListener(TinyFrame *tf, TF_Msg *msg)
+{
+    called |= 4;
+    TF_RemoveIdListener(tf, msg->frame_id);
+    TF_RemoveIdListener(tf, msg->frame_id);
+    return TF_NEXT;
+}
+
+TF_Result removedListener(TinyFrame *tf, TF_Msg *msg)
+{
+    (void) tf;
+    (void) msg;
+    called |= 2;
+    return TF_NEXT;
+}
+
+TF_Result oldestListener(TinyFrame *tf, TF_Msg *msg)
+{
+    (void) tf;
+    (void) msg;
+    called |= 1;
+    return TF_CLOSE;
+}
+
+/** Send a query whose listener removes itself on cleanup, return its frame ID */
+static TF_ID selfRemovingQuery(TinyFrame *tf, TF_ID *id_store, TF_TICKS timeout)
+{
+    TF_Msg msg;
+
+    TF_ClearMsg(&msg);
+    msg.type = 0x22;
+    msg.userdata = id_store;
+    TF_Query(tf, &msg, selfRemovingListener, NULL, timeout);
+    *id_store = msg.frame_id;
+    return msg.frame_id;
+}
+
+int main(void)
+{
+    TF_Msg msg;
+    TF_ID id1, id2;
+    uint8_t frame[32];
+    uint32_t len;
+    int i;
+
+    TF_InitStatic(&demo_tf, TF_MASTER);
+
+    // Removed by the user, the cleanup callback removes it again
+    TF_RemoveIdListener(&demo_tf, selfRemovingQuery(&demo_tf, &id1, 5));
+    // Expired by TF_Tick(), the cleanup callback removes it again
+    selfRemovingQuery(&demo_tf, &id2, 5);
+    for (i = 0; i < 20; i++) {
+        TF_Tick(&demo_tf);
+    }
+    if (cleanups != 2) {
+        printf("FAIL - %d cleanup callbacks, expected 2\n", cleanups);
+        return 1;
+    }
+
+    // The freed slots must be usable again, once each
+    TF_ClearMsg(&msg);
+    msg.type = 0x33;
+    TF_Query(&demo_tf, &msg, plainListener, countTimeout, 3);
+    id1 = msg.frame_id;
+    TF_ClearMsg(&msg);
+    msg.type = 0x33;
+    TF_Query(&demo_tf, &msg, plainListener, countTimeout, 4);
+    id2 = msg.frame_id;
+    for (i = 0; i < 20; i++) {
+        TF_Tick(&demo_tf);
+    }
+    if (timeouts != 2) {
+        printf("FAIL - %d listeners of frames %d, %d timed out, expected 2\n", timeouts, (int) id1, (int) id2);
+        return 1;
+    }
+
+    // Three listeners for one frame ID, the newest one removes itself and the next
+    // one during the dispatch. The oldest one must still get the frame.
+    TF_ClearMsg(&msg);
+    msg.frame_id = 0x10;
+    TF_AddIdListener(&demo_tf, &msg, oldestListener, NULL, 0);
+    TF_AddIdListener(&demo_tf, &msg, removedListener, NULL, 0);
+    TF_AddIdListener(&demo_tf, &msg, removeTwoListener, NULL, 0);
+    TF_ClearMsg(&msg);
+    msg.frame_id = 0x10;
+    msg.is_response = true;
+    msg.type = 0x44;
+    len = TF_ComposeFrame(&demo_tf, &msg, frame, sizeof(frame));
+    TF_Accept(&demo_tf, frame, len);
+    if (called != (4 | 1)) {
+        printf("FAIL - listeners called: %d, expected 5\n", called);
+        return 1;
+    }
+
+    // All ten slots are free again
+    for (i = 0; i < TF_MAX_ID_LST; i++) {
+        TF_ClearMsg(&msg);
+        if (!TF_Query(&demo_tf, &msg, plainListener, NULL, 0)) {
+            printf("FAIL - only %d ID listeners could be added\n", i);
+            return 1;
+        }
+    }
+
+    printf("OK - listeners removed from their cleanup callbacks\n");
+    return 0;
+}
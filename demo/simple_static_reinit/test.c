@@ -0,0 +1,91 @@
+//
+// Re-initialize and de-initialize a static instance with TF_DYNAMIC_LISTENERS.
+// Built with AddressSanitizer - a leak of the listener memory fails the run.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include "../../TinyFrame.h"
+#include "../utils.h"
+
+#define LISTENER_COUNT 20
+
+static TinyFrame demo_tf;
+
+static int received;
+
+/**
+ * This function should be defined in the application code.
+ * It implements the lowest layer - sending bytes to UART (or other)
+ */
+void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len)
+{
+    // Send it back as if we received it
+    TF_Accept(tf, buff, len);
+}
+
+/** Counts the frames that reached a listener */
+TF_Result countListener(TinyFrame *tf, TF_Msg *msg)
+{
+    (void) tf;
+    (void) msg;
+    received++;
+    return TF_STAY;
+}
+
+/** Add enough listeners of each kind to allocate several slabs and grow the indexes */
+static bool addListeners(TinyFrame *tf)
+{
+    TF_Msg msg;
+    int i;
+
+    for (i = 0; i < LISTENER_COUNT; i++) {
+        if (!TF_AddTypeListener(tf, (TF_TYPE) (0x1000 + i), countListener)) return false;
+        if (!TF_AddGenericListener(tf, countListener)) return false;
+
+        // timeout 0 - the ID listeners stay until de-init
+        TF_ClearMsg(&msg);
+        msg.type = 0x2000;
+        msg.data = (pu8) "query";
+        msg.len = 6;
+        if (!TF_Query(tf, &msg, countListener, NULL, 0)) return false;
+    }
+    return true;
+}
+
+int main(void)
+{
+    TF_Msg msg;
+    int round;
+
+    for (round = 0; round < 3; round++) {
+        // Init again without de-init - the previous listeners must be freed
+        if (!TF_InitStatic(&demo_tf, TF_MASTER)) return 1;
+        if (!addListeners(&demo_tf)) {
+            printf("FAIL - round %d: adding listeners failed\n", round);
+            return 1;
+        }
+
+        received = 0;
+        TF_ClearMsg(&msg);
+        msg.type = 0x1003;
+        msg.data = (pu8) "Hello";
+        msg.len = 6;
+        TF_Send(&demo_tf, &msg);
+
+        if (received != 1) {
+            printf("FAIL - round %d: %d listeners got the frame, expected 1\n", round, received);
+            return 1;
+        }
+        printf("OK - round %d\n", round);
+    }
+
+    TF_DeInitStatic(&demo_tf);
+    // Calling it again, or initializing after it, must be safe
+    TF_DeInitStatic(&demo_tf);
+    if (!TF_InitStatic(&demo_tf, TF_MASTER) || !addListeners(&demo_tf)) return 1;
+    TF_DeInitStatic(&demo_tf);
+
+    printf("OK - all listener memory released\n");
+    return 0;
+}
@@ -29,6 +29,11 @@
  #define TF_PARSER_TIMEOUT_TICKS 10
  #define TF_USE_MUTEX      1
  
+ // 发送合并：帧先放入缓冲区，满了或1个tick后一起写入(一次mq_send)
+ // 不超过mq的消息大小(MAX_MSG_SIZE)
+ #define TF_TX_COALESCE    256
+ #define TF_TX_FLUSH_TICKS 1
+ 
  // Error reporting with our logging system
  #define TF_Error(format, ...) LOG_ERROR(format, ##__VA_ARGS__)
  
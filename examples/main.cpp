@@ -23,6 +23,7 @@
 #include <fcntl.h>           // For O_* constants
 #include <sys/stat.h>        // For mode constants
 #include <mqueue.h>          // For POSIX message queue
+#include <poll.h>
 
 #include <boost/program_options.hpp>
 #include "../TinyFrame.h"
@@ -178,6 +179,7 @@ private:
 extern void tf_board_init(void *arg);
 extern void tf_board_cleanup();
 extern void tf_thread_start();
+extern bool tf_send_async(TF_TYPE type, const uint8_t *data, TF_LEN len);
 
 namespace po = boost::program_options;
 
@@ -247,48 +249,103 @@ void signal_handler(int sig) {
     running = false;
 }
 
-// 添加数据打包函数
-static std::vector<uint8_t> pack_imu_data(float ax, float ay, float az, 
-                                         float gx, float gy, float gz,
-                                         float mx, float my, float mz) {
-    tf_data_t data = {0};
-    data.data.imu_data.accel[0] = ax;
-    data.data.imu_data.accel[1] = ay;
-    data.data.imu_data.accel[2] = az;
-    data.data.imu_data.gyro[0] = gx;
-    data.data.imu_data.gyro[1] = gy;
-    data.data.imu_data.gyro[2] = gz;
-    data.data.imu_data.mag[0] = mx;
-    data.data.imu_data.mag[1] = my;
-    data.data.imu_data.mag[2] = mz;
-    data.timestamp = static_cast<uint32_t>(time(nullptr));
-    
-    return std::vector<uint8_t>(
-        reinterpret_cast<uint8_t*>(&data),
-        reinterpret_cast<uint8_t*>(&data) + sizeof(tf_data_t)
-    );
+// 数据打包函数，直接写入TF_ReserveFrame()返回的发送缓冲区（tf_data_t按字节对齐，可写任意地址）
+static void pack_imu_data(tf_data_t *data, const float v[9]) {
+    memset(data, 0, sizeof(tf_data_t));
+    data->data.imu_data.accel[0] = v[0];
+    data->data.imu_data.accel[1] = v[1];
+    data->data.imu_data.accel[2] = v[2];
+    data->data.imu_data.gyro[0] = v[3];
+    data->data.imu_data.gyro[1] = v[4];
+    data->data.imu_data.gyro[2] = v[5];
+    data->data.imu_data.mag[0] = v[6];
+    data->data.imu_data.mag[1] = v[7];
+    data->data.imu_data.mag[2] = v[8];
+    data->timestamp = static_cast<uint32_t>(time(nullptr));
 }
 
-static std::vector<uint8_t> pack_pressure_data(float pressure) {
-    tf_data_t data = {0};
-    data.data.pressure_data.pressure_hpa = pressure;
-    data.timestamp = static_cast<uint32_t>(time(nullptr));
-    
-    return std::vector<uint8_t>(
-        reinterpret_cast<uint8_t*>(&data),
-        reinterpret_cast<uint8_t*>(&data) + sizeof(tf_data_t)
-    );
+static void pack_pressure_data(tf_data_t *data, float pressure) {
+    memset(data, 0, sizeof(tf_data_t));
+    data->data.pressure_data.pressure_hpa = pressure;
+    data->timestamp = static_cast<uint32_t>(time(nullptr));
 }
 
-static std::vector<uint8_t> pack_command(uint8_t cmd) {
-    tf_data_t data = {0};
-    data.data.cmd.command = cmd;
-    data.timestamp = static_cast<uint32_t>(time(nullptr));
-    
-    return std::vector<uint8_t>(
-        reinterpret_cast<uint8_t*>(&data),
-        reinterpret_cast<uint8_t*>(&data) + sizeof(tf_data_t)
-    );
+static void pack_command(tf_data_t *data, uint8_t cmd) {
+    memset(data, 0, sizeof(tf_data_t));
+    data->data.cmd.command = cmd;
+    data->timestamp = static_cast<uint32_t>(time(nullptr));
+}
+
+// 解析后的发送请求，负载在发送时才打包
+struct tx_request {
+    TF_TYPE type;
+    uint8_t cmd;
+    float values[9];
+    float pressure;
+};
+
+// 解析 type:data 格式的发送请求，格式错误时抛出异常
+static tx_request parse_tx_request(const std::string &input) {
+    tx_request req = {};
+
+    size_t pos = input.find(':');
+    if (pos == std::string::npos) {
+        throw std::runtime_error("无效的命令格式，请使用 type:data 格式");
+    }
+    std::string type = input.substr(0, pos);
+    std::string data_str = input.substr(pos + 1);
+
+#if BOARD_ID == BOARD_SERVER_ID
+    // 服务端只处理控制命令
+    if (type == "cmd") {
+        if (data_str == "start") {
+            req.cmd = TF_CMD_START;
+        } else if (data_str == "stop") {
+            req.cmd = TF_CMD_STOP;
+        } else {
+            throw std::runtime_error("无效的控制命令");
+        }
+        req.type = TF_TYPE_CMD;
+    } else {
+        throw std::runtime_error("服务端只支持控制命令(cmd:start/stop)");
+    }
+#else
+    // 客户端只处理传感器数据
+    if (type == "imu") {
+        std::stringstream ss(data_str);
+        std::string value_str;
+        size_t count = 0;
+        while (std::getline(ss, value_str, ',')) {
+            if (count < 9) req.values[count] = std::stof(value_str);
+            count++;
+        }
+        
+        if (count != 9) {
+            throw std::runtime_error("IMU数据需要9个参数");
+        }
+        
+        req.type = TF_TYPE_SENSOR_IMU;
+    }
+    else if (type == "pressure") {
+        req.pressure = std::stof(data_str);
+        req.type = TF_TYPE_SENSOR_PRESSURE;
+    }
+    else {
+        throw std::runtime_error("客户端只支持IMU和压力传感器数据");
+    }
+#endif
+    return req;
+}
+
+// 按请求类型打包负载
+static void pack_tx_request(const tx_request &req, tf_data_t *data) {
+    if (req.type == TF_TYPE_SENSOR_IMU) {
+        pack_imu_data(data, req.values);
+    } else if (req.type == TF_TYPE_SENSOR_PRESSURE) {
+        pack_pressure_data(data, req.pressure);
+    } else {
+        pack_command(data, req.cmd);
+    }
 }
 
 int main(int argc, char *argv[]) {
@@ -365,79 +422,22 @@ int main(int argc, char *argv[]) {
             return 1;
         }
 
-        // 解析命令格式 type:data
-        size_t pos = input.find(':');
-        if (pos == std::string::npos) {
-            std::cerr << "无效的命令格式，请使用 type:data 格式" << std::endl;
-            std::cout << desc << std::endl;
-            return 1;
-        }
-        
-        std::string type = input.substr(0, pos);
-        std::string data_str = input.substr(pos + 1);
-        std::vector<uint8_t> data;
-        
         try {
-            // 创建TinyFrame消息
-            TF_Msg msg;
-            TF_ClearMsg(&msg);
-            
-#if BOARD_ID == BOARD_SERVER_ID
-            // 服务端只处理控制命令
-            if (type == "cmd") {
-                uint8_t cmd;
-                if (data_str == "start") {
-                    cmd = TF_CMD_START;
-                } else if (data_str == "stop") {
-                    cmd = TF_CMD_STOP;
-                } else {
-                    throw std::runtime_error("无效的控制命令");
-                }
-                data = pack_command(cmd);
-                msg.type = TF_TYPE_CMD;
-                msg.data = data.data();
-                msg.len = data.size();
-            } else {
-                throw std::runtime_error("服务端只支持控制命令(cmd:start/stop)");
-            }
-#else
-            // 客户端只处理传感器数据
-            if (type == "imu") {
-                std::vector<float> values;
-                std::stringstream ss(data_str);
-                std::string value_str;
-                while (std::getline(ss, value_str, ',')) {
-                    values.push_back(std::stof(value_str));
-                }
-                
-                if (values.size() != 9) {
-                    throw std::runtime_error("IMU数据需要9个参数");
-                }
-                
-                data = pack_imu_data(
-                    values[0], values[1], values[2],
-                    values[3], values[4], values[5],
-                    values[6], values[7], values[8]
-                );
-                msg.type = TF_TYPE_SENSOR_IMU;
-                msg.data = data.data();
-                msg.len = data.size();
-            }
-            else if (type == "pressure") {
-                float pressure = std::stof(data_str);
-                data = pack_pressure_data(pressure);
-                msg.type = TF_TYPE_SENSOR_PRESSURE;
-                msg.data = data.data();
-                msg.len = data.size();
-            }
-            else {
-                throw std::runtime_error("客户端只支持IMU和压力传感器数据");
-            }
-#endif
+            // 解析参数，负载在发送时直接打包到发送缓冲区
+            tx_request req = parse_tx_request(input);
             
             // 发送数据到另一端
             for (int i = 0; i < repeat_count; i++) {
-                bool sent = TF_Send(tf_ctx, &msg);
+                // 在发送缓冲区中预留负载，打包后提交（计算校验并发送），无需中间缓冲和拷贝
+                auto *data = reinterpret_cast<tf_data_t *>(
+                    TF_ReserveFrame(tf_ctx, req.type, sizeof(tf_data_t)));
+                bool sent = data != nullptr;
+                if (sent) {
+                    pack_tx_request(req, data);
+                    TF_CommitFrame(tf_ctx);
+                }
+                // 测试模式没有TF线程调用TF_Tick()，需手动写出合并缓冲区
+                if (sent) sent = TF_Flush(tf_ctx);
                 if (sent) {
                     std::cout << "消息发送成功 (" << (i + 1) << "/" << repeat_count << ")" << std::endl;
                     if (i < repeat_count - 1) {
@@ -471,10 +471,39 @@ int main(int argc, char *argv[]) {
         
         // 启动TinyFrame处理线程
         tf_thread_start();
+        std::cout << "输入 type:data 发送数据(格式同 -t 参数)" << std::endl;
         
-        // 主线程等待退出信号
+        // 主线程读取标准输入的发送请求，经发送队列交给TX线程，直到收到退出信号
+        bool stdin_open = true;
         while (running) {
-            sleep(1);
+            if (!stdin_open) {
+                sleep(1);
+                continue;
+            }
+
+            struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+            if (poll(&pfd, 1, 1000) <= 0) continue;  // 超时或被信号打断
+
+            std::string line;
+            if (!std::getline(std::cin, line)) {
+                stdin_open = false;  // 标准输入已关闭，只等待退出信号
+                continue;
+            }
+            if (line.empty()) continue;
+
+            try {
+                tx_request req = parse_tx_request(line);
+                tf_data_t payload;
+                pack_tx_request(req, &payload);
+                // 入队不会阻塞，由TX线程组帧发送
+                if (tf_send_async(req.type, reinterpret_cast<const uint8_t *>(&payload), sizeof(payload))) {
+                    std::cout << "消息已加入发送队列" << std::endl;
+                } else {
+                    std::cerr << "发送队列已满，消息丢弃" << std::endl;
+                }
+            } catch (const std::exception& e) {
+                std::cerr << "错误: " << e.what() << std::endl;
+            }
         }
         
         // 清理资源
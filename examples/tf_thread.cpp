@@ -2,7 +2,9 @@
 #include <stdarg.h>
 /* POSIX Header files */
 #include <pthread.h>
+#include <semaphore.h>
 #include <unistd.h>
+#include <time.h>
 #include <stddef.h>
 #include <stdbool.h>
 
@@ -15,13 +17,36 @@
 
 // 配置参数
 #define TF_THREADSTACKSIZE      1024
-#define TF_PROCESS_INTERVAL     3     // 处理间隔(ms)
+#define TF_PROCESS_INTERVAL     3     // 处理间隔(ms)，也是一个TF tick的时长
+#define TF_IDLE_SLEEP_MAX       100   // 异步接收时空闲休眠的上限(ms)
+#define TF_TXQ_SIZE             32    // 发送队列长度(必须是2的幂)
+#define TF_TXQ_DATA_MAX         64    // 发送队列中每条消息的最大长度
 
 /*---------- global variables ----------*/
 rf_device_t *rf_dev_handle = NULL;  // RF设备句柄
 TinyFrame *tf_ctx = NULL;    // TinyFrame上下文
 pthread_mutex_t tf_mutex;  // TinyFrame互斥锁
 
+/*
+ * 发送队列：多生产者单消费者的无锁环形队列(有界，每个槽带序号)
+ * 任意线程通过tf_send_async()入队，由TX线程取出后组帧发送，
+ * 生产者不会因TF的互斥锁或底层发送而阻塞。
+ *
+ * 槽的序号seq：等于pos时空闲，可由第pos个入队者写入；
+ * 等于pos+1时已写好，可由TX线程取出；取出后设为pos+TF_TXQ_SIZE，供下一轮使用。
+ */
+typedef struct {
+    uint32_t seq;
+    TF_TYPE type;
+    TF_LEN len;
+    uint8_t data[TF_TXQ_DATA_MAX];
+} tf_txq_slot_t;
+
+static tf_txq_slot_t tf_txq[TF_TXQ_SIZE];
+static uint32_t tf_txq_head;  // 下一个入队位置(生产者间用CAS竞争)
+static uint32_t tf_txq_tail;  // 下一个出队位置(只有TX线程使用)
+static sem_t tf_txq_sem;      // 入队后唤醒TX线程
+
 #ifdef RF_RX_MODE_ASYNC
 /**
  * @brief RF接收回调函数
@@ -167,6 +192,81 @@ static bool tf_init() {
     return true;
 }
 
+/**
+ * @brief 获取单调时钟(ms)
+ */
+static uint64_t tf_clock_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief 把消息放入发送队列，由TX线程发送(可在任意线程调用，不会阻塞)
+ *
+ * @return false - 队列已满或数据过长
+ */
+bool tf_send_async(TF_TYPE type, const uint8_t *data, TF_LEN len) {
+    if (len > TF_TXQ_DATA_MAX || (len > 0 && data == NULL)) return false;
+
+    tf_txq_slot_t *slot;
+    uint32_t pos = __atomic_load_n(&tf_txq_head, __ATOMIC_RELAXED);
+    while (1) {
+        slot = &tf_txq[pos & (TF_TXQ_SIZE - 1)];
+        int32_t diff = (int32_t)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+        if (diff == 0) {
+            // 槽空闲，占用位置pos(失败时pos被更新为当前的head)
+            if (__atomic_compare_exchange_n(&tf_txq_head, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // 槽还没被TX线程取出 - 队列已满
+            return false;
+        } else {
+            // 其他生产者已占用了pos
+            pos = __atomic_load_n(&tf_txq_head, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->type = type;
+    slot->len = len;
+    if (len > 0) memcpy(slot->data, data, len);
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+    sem_post(&tf_txq_sem);
+    return true;
+}
+
+/**
+ * @brief TX线程：取出发送队列中的消息并发送
+ */
+static void *tf_tx_thread(void *arg) {
+    while (1) {
+        while (sem_wait(&tf_txq_sem) != 0) {} // 被信号打断时重试
+
+        // 一次取完队列中已有的消息，合并后一起写出
+        while (1) {
+            tf_txq_slot_t *slot = &tf_txq[tf_txq_tail & (TF_TXQ_SIZE - 1)];
+            if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != tf_txq_tail + 1) break;
+
+            TF_Msg msg;
+            TF_ClearMsg(&msg);
+            msg.type = slot->type;
+            msg.data = slot->data;
+            msg.len = slot->len;
+            if (!TF_Send(tf_ctx, &msg)) {
+                LOG_ERROR("Failed to send queued message, type=%u", (unsigned int)msg.type);
+            }
+
+            __atomic_store_n(&slot->seq, tf_txq_tail + TF_TXQ_SIZE, __ATOMIC_RELEASE);
+            tf_txq_tail++;
+        }
+        TF_Flush(tf_ctx);
+    }
+    return NULL;
+}
+
 /**
  * @brief TinyFrame线程主函数
  */
@@ -190,7 +290,17 @@ void *tf_thread(void *arg) {
         LOG_ERROR("TinyFrame init failed");
         return NULL;
     }
+
+    // 启动TX线程，开始发送队列中的消息
+    pthread_t tx_thread;
+    if (pthread_create(&tx_thread, NULL, tf_tx_thread, NULL) != 0) {
+        LOG_ERROR("Failed to create TF TX thread");
+        return NULL;
+    }
+    pthread_detach(tx_thread);
     
+    uint64_t last_tick_ms = tf_clock_ms();
+
     // 主循环
     while (1) {
 #ifdef RF_RX_MODE_ASYNC
@@ -209,11 +319,24 @@ void *tf_thread(void *arg) {
         }
 #endif // RF_RX_MODE_ASYNC
         
-        // 定期调用TF_Tick以支持超时功能
-        TF_Tick(tf_ctx);
+        // 按实际经过的时间推进TF时基，休眠期间的tick一次补齐
+        uint64_t ticks = (tf_clock_ms() - last_tick_ms) / TF_PROCESS_INTERVAL;
+        if (ticks > 0) {
+            if (ticks > UINT16_MAX) ticks = UINT16_MAX; // TF_TICKS为uint16_t
+            TF_TickN(tf_ctx, (TF_TICKS)ticks);
+            last_tick_ms += ticks * TF_PROCESS_INTERVAL;
+        }
         
         // 休眠
+#ifdef RF_RX_MODE_ASYNC
+        // 数据由接收回调处理，只需在下一个超时到期时醒来
+        // (期间新添加的监听器超时最多延迟TF_IDLE_SLEEP_MAX)
+        uint32_t sleep_ms = (uint32_t)TF_NextDeadline(tf_ctx) * TF_PROCESS_INTERVAL;
+        if (sleep_ms == 0 || sleep_ms > TF_IDLE_SLEEP_MAX) sleep_ms = TF_IDLE_SLEEP_MAX;
+        usleep(sleep_ms * 1000);
+#else
         usleep(TF_PROCESS_INTERVAL * 1000);
+#endif // RF_RX_MODE_ASYNC
     }
     
     return NULL;
@@ -235,6 +358,14 @@ void tf_thread_start() {
     // 初始化互斥锁
     pthread_mutex_init(&tf_mutex, NULL);
 
+    // 初始化发送队列
+    for (uint32_t i = 0; i < TF_TXQ_SIZE; i++) {
+        tf_txq[i].seq = i;
+    }
+    tf_txq_head = 0;
+    tf_txq_tail = 0;
+    sem_init(&tf_txq_sem, 0, 0);
+
     // 创建线程
     pthread_t thread;
     pthread_attr_t attrs;
@@ -262,6 +393,7 @@ void tf_board_cleanup() {
     
     // 销毁互斥锁
     pthread_mutex_destroy(&tf_mutex);
+    sem_destroy(&tf_txq_sem);
 }
 
 